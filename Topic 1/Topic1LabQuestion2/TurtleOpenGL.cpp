@@ -14,20 +14,45 @@
 //   g++ TurtleOpenGL.cpp -o turtle -framework OpenGL -framework GLUT
 //
 // Linux (freeglut):
-//   g++ TurtleOpenGL.cpp -o turtle -lGL -lGLU -lglut
+//   g++ TurtleOpenGL.cpp -o turtle -lGL -lGLU -lglut -lEGL
 //
 // Windows (with freeglut installed and in your include/lib paths):
 //   g++ TurtleOpenGL.cpp -o turtle -lfreeglut -lopengl32 -lglu32
+//
+// FRAME TIMES:
+//   Press F to show frame / GL submission / GPU times (see
+//   ../../common/frame_timer.h). ./turtle --frame-csv times.csv writes
+//   one row per frame.
+//
+// OFFSCREEN (no window; Linux, add -lEGL to the build):
+//   ./turtle --offscreen --frames 100 --image turtle.png
+//   renders the drawing into an offscreen framebuffer and prints the
+//   frame times (see ../../common/offscreen.h).
+//
+// SEGMENT BUFFER:
+//   The move functions do not draw. Each segment is recorded (both
+//   ends, with the current color) into one array, and TurtleFlush()
+//   draws the whole array with a single glDrawArrays() call at the end
+//   of TurtleDemoDrawing(). ./turtle --spiral N adds a spiral of N more
+//   segments to the demo, e.g. --spiral 1000000. --immediate (or V)
+//   goes back to one glBegin/glEnd pair per segment, for comparison.
 
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <vector>
 
 #ifdef __APPLE__
     #include <GLUT/glut.h>
 #else
+    #define GL_GLEXT_PROTOTYPES  // declare timer query entry points
     #include <GL/glut.h>
 #endif
 
+#include "../../common/frame_timer.h"
+#include "../../common/offscreen.h"
+
 // Mathematical constants
 constexpr float PI = 3.14159265358979323846f;
 
@@ -43,6 +68,65 @@ struct Turtle {
 
 Turtle gTurtle;
 
+// ------------------------ SEGMENT BUFFER ----------------------
+
+// One end of a recorded segment: position and color, interleaved so
+// the buffer can be handed to glVertexPointer/glColorPointer as is
+struct TurtleVertex {
+    float x, y;
+    float r, g, b;
+};
+
+// Segments recorded since the last TurtleFlush(), two vertices each.
+// Flushing empties it but keeps the memory, so redrawing the same
+// picture every frame does not reallocate.
+std::vector<TurtleVertex> gTurtleSegments;
+
+// Draw each segment with its own glColor3f + glBegin/glEnd instead
+// (--immediate, V)
+bool gImmediate = false;
+
+// Extra spiral segments drawn by the demo (--spiral N)
+long long gSpiralSegments = 0;
+
+// RecordSegment(): append the segment (x0,y0)-(x1,y1) in the current color.
+void TurtleRecordSegment(float x0, float y0, float x1, float y1) {
+    TurtleVertex start = {x0, y0, gTurtle.r, gTurtle.g, gTurtle.b};
+    TurtleVertex end = {x1, y1, gTurtle.r, gTurtle.g, gTurtle.b};
+    gTurtleSegments.push_back(start);
+    gTurtleSegments.push_back(end);
+}
+
+// Flush(): draw every recorded segment, then empty the buffer.
+// Client-side vertex arrays are OpenGL 1.1, so this needs no extension
+// loader (unlike buffer objects on Windows).
+void TurtleFlush() {
+    if (gTurtleSegments.empty()) {
+        return;
+    }
+    if (gImmediate) {
+        for (size_t i = 0; i < gTurtleSegments.size(); i += 2) {
+            const TurtleVertex& a = gTurtleSegments[i];
+            const TurtleVertex& b = gTurtleSegments[i + 1];
+            glColor3f(a.r, a.g, a.b);
+            glBegin(GL_LINES);
+                glVertex2f(a.x, a.y);
+                glVertex2f(b.x, b.y);
+            glEnd();
+        }
+    } else {
+        const GLsizei stride = sizeof(TurtleVertex);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(2, GL_FLOAT, stride, &gTurtleSegments[0].x);
+        glColorPointer(3, GL_FLOAT, stride, &gTurtleSegments[0].r);
+        glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(gTurtleSegments.size()));
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+    }
+    gTurtleSegments.clear();
+}
+
 // ------------------------ TURTLE API --------------------------
 
 // SetPosition(x, y): move turtle without drawing.
@@ -84,7 +168,7 @@ void TurtleSetColor(float r, float g, float b) {
     gTurtle.b = b;
 }
 
-// MoveForward(distance): move in current direction, draw line if penDown.
+// MoveForward(distance): move in current direction, record a line if penDown.
 void TurtleMoveForward(float distance) {
     float angleRad = gTurtle.angleDeg * PI / 180.0f;
 
@@ -95,18 +179,14 @@ void TurtleMoveForward(float distance) {
     float y1 = y0 + distance * std::sin(angleRad);
 
     if (gTurtle.penDown) {
-        glColor3f(gTurtle.r, gTurtle.g, gTurtle.b);
-        glBegin(GL_LINES);
-            glVertex2f(x0, y0);
-            glVertex2f(x1, y1);
-        glEnd();
+        TurtleRecordSegment(x0, y0, x1, y1);
     }
 
     gTurtle.x = x1;
     gTurtle.y = y1;
 }
 
-// MoveTo(x,y,draw): move to absolute coordinates; if draw==true draw a line
+// MoveTo(x,y,draw): move to absolute coordinates; if draw==true record a line
 // from current position to (x,y). Units are in the current projection space.
 void TurtleMoveTo(float x, float y, bool draw = true) {
     float x0 = gTurtle.x;
@@ -115,11 +195,7 @@ void TurtleMoveTo(float x, float y, bool draw = true) {
     float y1 = y;
 
     if (draw) {
-        glColor3f(gTurtle.r, gTurtle.g, gTurtle.b);
-        glBegin(GL_LINES);
-            glVertex2f(x0, y0);
-            glVertex2f(x1, y1);
-        glEnd();
+        TurtleRecordSegment(x0, y0, x1, y1);
     }
 
     gTurtle.x = x1;
@@ -128,8 +204,24 @@ void TurtleMoveTo(float x, float y, bool draw = true) {
 
 // ------------------------ DEMO DRAWING ------------------------
 
+// Spiral of `segments` segments from the centre, each a little longer
+// than the last and turned by 121 degrees, fading from blue to orange.
+// Stresses the segment buffer (--spiral N).
+void TurtleDemoSpiral(long long segments) {
+    TurtlePenUp();
+    TurtleSetPosition(0.0f, 0.0f);
+    TurtlePenDown();
+    for (long long i = 0; i < segments; ++i) {
+        float t = static_cast<float>(i + 1) / static_cast<float>(segments);
+        TurtleSetColor(t, 0.5f, 1.0f - t);
+        TurtleMoveForward(0.9f * t);
+        TurtleRotateLeft(121.0f);
+    }
+}
+
 // This function demonstrates calling the turtle API to draw
-// a simple pattern (a square + a triangle).
+// a simple pattern (a square + a triangle). The segments are only
+// recorded until the TurtleFlush() at the end.
 void TurtleDemoDrawing() {
     // Reset turtle to a known state
     gTurtle.x = -0.5f;
@@ -171,11 +263,26 @@ void TurtleDemoDrawing() {
         TurtlePenDown();
         TurtleRotateRight(30.0f);
     }
+
+    if (gSpiralSegments > 0) {
+        TurtleDemoSpiral(gSpiralSegments);
+    }
+
+    // Everything above is drawn here, in one call
+    TurtleFlush();
 }
 
 // ------------------------ OPENGL SETUP ------------------------
 
+// Frame-time statistics (F toggles the overlay)
+FrameTimer gFrameTimer;
+
+// Windowless rendering (--offscreen)
+OffscreenOptions gOffscreen;
+
 void DisplayCallback() {
+    gFrameTimer.beginFrame();
+    gFrameTimer.beginSubmission();
     glClear(GL_COLOR_BUFFER_BIT);
 
     // Reset modelview matrix
@@ -185,7 +292,31 @@ void DisplayCallback() {
     // All turtle drawing happens here:
     TurtleDemoDrawing();
 
-    glutSwapBuffers();
+    gFrameTimer.endSubmission();
+    gFrameTimer.endFrame();
+    if (!gOffscreen.enabled) {
+        glutSwapBuffers();
+    }
+}
+
+void KeyboardCallback(unsigned char key, int x, int y) {
+    switch (key) {
+        case 27:  // ESC
+            exit(0);
+            break;
+        case 'f':
+        case 'F':
+            gFrameTimer.toggleOverlay();
+            glutPostRedisplay();
+            break;
+        case 'v':
+        case 'V':
+            gImmediate = !gImmediate;
+            std::cout << "Drawing: " << (gImmediate ? "glBegin/glEnd per segment" : "One glDrawArrays")
+                      << std::endl;
+            glutPostRedisplay();
+            break;
+    }
 }
 
 void ReshapeCallback(int width, int height) {
@@ -223,6 +354,35 @@ int main(int argc, char** argv) {
     gTurtle.g = 1.0f;
     gTurtle.b = 1.0f;
 
+    // Our options; anything else is left for glutInit()
+    for (int i = 1; i < argc; ++i) {
+        if (gOffscreen.parse(argc, argv, i)) {
+            continue;
+        }
+        if (std::strcmp(argv[i], "--frame-csv") == 0 && i + 1 < argc) {
+            if (!gFrameTimer.openCsv(argv[++i])) {
+                std::cerr << "Error: cannot write " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--spiral") == 0 && i + 1 < argc) {
+            gSpiralSegments = static_cast<long long>(std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--immediate") == 0) {
+            gImmediate = true;
+        }
+    }
+    if (gSpiralSegments < 0) {
+        std::cerr << "Error: --spiral needs a segment count of 0 or more" << std::endl;
+        return 1;
+    }
+
+    if (gOffscreen.enabled) {
+        gOffscreen.defaultSize(800, 600);
+        return renderOffscreen(gOffscreen, gFrameTimer, false, []() {
+            InitGL();
+            ReshapeCallback(gOffscreen.width, gOffscreen.height);
+        }, DisplayCallback);
+    }
+
     // GLUT setup
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB);
@@ -233,6 +393,7 @@ int main(int argc, char** argv) {
 
     glutDisplayFunc(DisplayCallback);
     glutReshapeFunc(ReshapeCallback);
+    glutKeyboardFunc(KeyboardCallback);
 
     glutMainLoop();
     return 0;
@@ -0,0 +1,108 @@
+#!/bin/bash
+
+# Benchmark Sweep for the Sierpinski Gasket Project
+# Runs every generator and renderer at a sweep of sizes and collects the
+# results into one JSON file, so runs from two commits can be diffed:
+#
+#   ./bench.sh [OUTPUT]        (default bench.json; `make bench` builds first)
+#
+# Each run appends one JSON line (--bench-json, see common/bench_report.h)
+# with its parameters, generation throughput, submission / GPU times and
+# peak memory. Renderers run offscreen (EGL), so no display is needed.
+#
+# The sweeps can be narrowed from the environment, e.g.
+#   FRAMES=5 POINTS="1e4 1e6" DEPTHS="0 4 8" BRICKS="" ./bench.sh
+# (an empty list skips that sweep)
+
+OUTPUT="${1:-bench.json}"
+FRAMES="${FRAMES:-10}"
+POINTS="${POINTS-1e4 1e5 1e6 1e7 1e8 1e9}"        # chaos game, generated headless
+RENDER_POINTS="${RENDER_POINTS-1e4 1e5 1e6 1e7}"   # chaos game, drawn in 2D and 3D (kept in memory)
+DEPTHS="${DEPTHS-0 1 2 3 4 5 6 7 8 9 10 11 12 13 14}"
+BRICKS="${BRICKS-1e2 1e3 1e4 1e5 1e6}"
+# Topic 4 is built with CMake; its sweep is skipped if it has not been
+STAIRWELL="${STAIRWELL:-../../Topic 4/build/stairwell_scene}"
+
+LINES="$(mktemp)"
+trap 'rm -f "$LINES"' EXIT
+FAILED=0
+
+# Run one benchmark in directory $1, appending its result to $LINES
+run_in() {
+    local dir=$1
+    shift
+    echo "  $*"
+    if ! (cd "$dir" && "$@" --bench-json "$LINES" > /dev/null 2>&1); then
+        echo "    failed"
+        FAILED=$((FAILED + 1))
+    fi
+}
+
+run() {
+    run_in . "$@"
+}
+
+echo "Benchmark sweep: $FRAMES frames per offscreen run"
+
+echo "2D random, generation:"
+for points in $POINTS; do
+    run ./gasket_2d_random --headless --seed 0 --points "$points" --output /dev/null
+done
+
+echo "2D random, rendering:"
+for points in $RENDER_POINTS; do
+    run ./gasket_2d_random --offscreen --frames "$FRAMES" --points "$points"
+done
+
+echo "2D subdivision, generation (unrolled vs. odometer vs. recursive):"
+for depth in $DEPTHS; do
+    run ./gasket_2d_subdivision --headless --depth "$depth"
+done
+
+echo "2D subdivision, rendering:"
+for depth in $DEPTHS; do
+    run ./gasket_2d_subdivision --offscreen --frames "$FRAMES" --depth "$depth"
+done
+
+echo "3D tetrahedron:"
+for depth in $DEPTHS; do
+    run ./gasket_3d_tetrahedron --offscreen --frames "$FRAMES" --depth "$depth"
+    run ./gasket_3d_tetrahedron --offscreen --frames "$FRAMES" --depth "$depth" --instanced
+done
+
+echo "3D chaos game point cloud:"
+for points in $RENDER_POINTS; do
+    run ./gasket_3d_tetrahedron --offscreen --frames "$FRAMES" --chaos "$points"
+done
+
+if [ -n "$BRICKS" ]; then
+    if [ -x "$STAIRWELL" ]; then
+        echo "Stairwell scene:"
+        for bricks in $BRICKS; do
+            # Run next to its shaders
+            run_in "$(dirname "$STAIRWELL")" "./$(basename "$STAIRWELL")" \
+                --offscreen --frames "$FRAMES" --bricks "$bricks"
+        done
+    else
+        echo "Stairwell scene: skipped, $STAIRWELL not built (see Topic 4/README.md)"
+    fi
+fi
+
+# One result object per line, so diffs between runs stay readable
+COMMIT="$(git rev-parse --short HEAD 2> /dev/null || echo unknown)"
+{
+    echo "{"
+    echo "  \"commit\": \"$COMMIT\","
+    echo "  \"date\": \"$(date -u +%Y-%m-%dT%H:%M:%SZ)\","
+    echo "  \"machine\": \"$(uname -s) $(uname -m)\","
+    echo "  \"results\": ["
+    sed -e 's/^/    /' -e '$!s/$/,/' "$LINES"
+    echo "  ]"
+    echo "}"
+} > "$OUTPUT"
+
+echo "Wrote $(wc -l < "$LINES") results to $OUTPUT"
+if [ $FAILED -gt 0 ]; then
+    echo "$FAILED runs failed"
+    exit 1
+fi
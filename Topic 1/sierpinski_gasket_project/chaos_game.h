@@ -0,0 +1,289 @@
+/*
+ * chaos_game.h - Multithreaded chaos-game point generator
+ *
+ * The chaos game is a serial dependency chain: every point depends on
+ * the one before it. The attractor does not depend on the starting
+ * point, though, so after a short burn-in any number of independent
+ * chains sample the same gasket. ParallelChaosGame runs one chain per
+ * worker thread, each with its own random stream (the same seed
+ * jump()ed once per worker), and concatenates their output.
+ *
+ * Within a worker the chains are further split into CHAOS_MAX_LANES
+ * (16) logical chains, however many SIMD lanes the kernel has: a
+ * narrower kernel advances them in groups of its width. A run uses
+ * threads * 16 independent chains in total.
+ *
+ * Output is deterministic for a given seed, thread count and burn-in,
+ * whichever kernel runs and however it is requested: the output is
+ * cut into slices of SLICE_POINTS points dealt to the workers in turn,
+ * each worker's stream does not depend on how many points a call asks
+ * for, and every kernel computes the same 16 chains bit for bit. One
+ * call for N points gives the same points as several calls adding up
+ * to N.
+ *
+ * The threading lives in ParallelChains<Chain>, which any chain type
+ * with generate() can use; ifs_engine.h runs general iterated function
+ * systems on it.
+ */
+
+#ifndef CHAOS_GAME_H
+#define CHAOS_GAME_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "prng.h"
+#include "chaos_kernels.h"
+
+/*
+ * The chains owned by one worker thread
+ *
+ * A worker advances CHAOS_MAX_LANES chains, all driven by the
+ * worker's random stream; the kernel (see chaos_kernels.h) runs over
+ * them `lanes` at a time. Vertex choices are drawn in whole blocks of
+ * BLOCK_CHOICES and used up row by row (one choice per chain), so the
+ * random stream is consumed the same way whatever the calls ask for.
+ * A call that ends inside a row keeps the rest of the row for the
+ * next call.
+ */
+template <typename Rng>
+struct ChaosChain {
+    // Vertex choices drawn per kernel call
+    static const int BLOCK_CHOICES = 4096;
+
+    // Floats per point
+    static const int DIMENSIONS = 2;
+
+    VertexPicker<Rng> picker;
+    ChaosKernelFn kernel;
+    int lanes;      // chains per kernel call, a divisor of CHAOS_MAX_LANES
+    float tableX[CHAOS_MAX_LANES];
+    float tableY[CHAOS_MAX_LANES];
+    float laneX[CHAOS_MAX_LANES];
+    float laneY[CHAOS_MAX_LANES];
+    std::vector<uint8_t> choices;
+    size_t nextChoice;      // first unused choice in choices
+    float pending[2 * CHAOS_MAX_LANES];     // last row, if a call ended inside it
+    int pendingPoints;      // points at the end of pending not handed out yet
+
+    ChaosChain(const Rng& rng, const float vertices[][2], ChaosKernelKind kind)
+        : picker(rng), choices(BLOCK_CHOICES), nextChoice(BLOCK_CHOICES), pendingPoints(0) {
+        kind = resolveChaosKernel(kind);
+        kernel = chaosKernelFunction(kind);
+        lanes = chaosKernelLanes(kind);
+        // Pad the table by repeating the last vertex; choices never exceed 2
+        for (int i = 0; i < CHAOS_MAX_LANES; i++) {
+            tableX[i] = vertices[i < 3 ? i : 2][0];
+            tableY[i] = vertices[i < 3 ? i : 2][1];
+            laneX[i] = 0.0f;
+            laneY[i] = 0.0f;
+        }
+    }
+
+    // Advance every chain count steps without storing (burn-in)
+    void discard(long long count) {
+        float scratch[2 * CHAOS_MAX_LANES];
+        for (long long i = 0; i < count; i++) {
+            advanceRows(scratch, 1);
+        }
+    }
+
+    // Store count interleaved x, y pairs into out
+    void generate(float* out, long long count) {
+        // The rest of the row the previous call stopped inside
+        long long n = std::min<long long>(count, pendingPoints);
+        const float* rest = pending + 2 * (CHAOS_MAX_LANES - pendingPoints);
+        std::copy(rest, rest + 2 * n, out);
+        pendingPoints -= static_cast<int>(n);
+        out += 2 * n;
+        count -= n;
+
+        long long rows = count / CHAOS_MAX_LANES;
+        advanceRows(out, rows);
+        out += 2 * rows * CHAOS_MAX_LANES;
+        count -= rows * CHAOS_MAX_LANES;
+
+        // Fewer points left than chains: keep the rest of one more row
+        if (count > 0) {
+            advanceRows(pending, 1);
+            std::copy(pending, pending + 2 * count, out);
+            pendingPoints = CHAOS_MAX_LANES - static_cast<int>(count);
+        }
+    }
+
+    // Advance every chain `rows` steps, storing one row of
+    // CHAOS_MAX_LANES points per step at out
+    void advanceRows(float* out, long long rows) {
+        while (rows > 0) {
+            if (nextChoice == choices.size()) {
+                picker.fill(choices.data(), choices.size());
+                nextChoice = 0;
+            }
+            long long steps = std::min<long long>(rows, (choices.size() - nextChoice) / CHAOS_MAX_LANES);
+            advance(out, steps);
+            nextChoice += steps * CHAOS_MAX_LANES;
+            out += 2 * steps * CHAOS_MAX_LANES;
+            rows -= steps;
+        }
+    }
+
+    // Run the kernel over all chains, one group of `lanes` at a time,
+    // for `steps` rows of choices from nextChoice
+    void advance(float* out, long long steps) {
+        const uint8_t* rows = choices.data() + nextChoice;
+        for (int g = 0; g < CHAOS_MAX_LANES; g += lanes) {
+            kernel(tableX, tableY, laneX + g, laneY + g, rows + g, out + 2 * g,
+                   steps, CHAOS_MAX_LANES);
+        }
+    }
+};
+
+/*
+ * Generator interface, so callers can keep a generator alive (e.g.
+ * between frames) without knowing which Rng it was built with
+ */
+class ChaosGenerator {
+public:
+    // consumer(thread, points, n) - see ParallelChaosGame::consume()
+    typedef std::function<void(int, const float*, long long)> Consumer;
+
+    virtual ~ChaosGenerator() {}
+    virtual int threadCount() const = 0;
+    virtual int dimensions() const = 0;     // floats per point
+    virtual void generate(float* out, long long count) = 0;
+    virtual void consume(long long count, const Consumer& consumer) = 0;
+};
+
+/*
+ * N independent chains of type Chain advanced in parallel. Chain must
+ * have DIMENSIONS and generate(out, count); subclasses fill chains.
+ */
+template <typename Chain>
+class ParallelChains : public ChaosGenerator {
+public:
+    int threadCount() const override {
+        return static_cast<int>(chains.size());
+    }
+
+    int dimensions() const override {
+        return Chain::DIMENSIONS;
+    }
+
+    /*
+     * Fill out with count points (DIMENSIONS * count floats). Chains
+     * continue where they left off, so repeated calls extend the same
+     * output as one larger call would.
+     */
+    void generate(float* out, long long count) override {
+        long long first = position;
+        position += count;
+        runWorkers([this, out, first, count](int t) {
+            long long round = SLICE_POINTS * threadCount();
+            long long k = ownedBefore(t, first);
+            long long end = ownedBefore(t, first + count);
+            while (k < end) {
+                // One worker's slices are contiguous only with one worker
+                long long n = threadCount() == 1 ? end - k
+                              : std::min(end - k, SLICE_POINTS - k % SLICE_POINTS);
+                long long index = k / SLICE_POINTS * round + t * SLICE_POINTS + k % SLICE_POINTS;
+                chains[t].generate(out + Chain::DIMENSIONS * (index - first), n);
+                k += n;
+            }
+        });
+    }
+
+    /*
+     * Generate count points without keeping them: each worker fills a
+     * private buffer CONSUME_CHUNK points at a time and hands it to
+     * consumer(t, points, n). The consumer runs on worker t's thread and
+     * must only touch state owned by worker t (e.g. its own histogram).
+     */
+    void consume(long long count, const Consumer& consumer) override {
+        long long first = position;
+        position += count;
+        runWorkers([this, &consumer, first, count](int t) {
+            long long slice = ownedBefore(t, first + count) - ownedBefore(t, first);
+            std::vector<float> buffer(Chain::DIMENSIONS * CONSUME_CHUNK);
+            while (slice > 0) {
+                long long n = slice < CONSUME_CHUNK ? slice : CONSUME_CHUNK;
+                chains[t].generate(buffer.data(), n);
+                consumer(t, buffer.data(), n);
+                slice -= n;
+            }
+        });
+    }
+
+protected:
+    std::vector<Chain> chains;
+
+private:
+    // Points per consumer call; small enough to stay in cache
+    static const long long CONSUME_CHUNK = 16384;
+
+    // Output points per turn of each worker: points 0 to SLICE_POINTS
+    // come from worker 0, the next SLICE_POINTS from worker 1, and so on
+    // round the workers
+    static const long long SLICE_POINTS = 1024;
+
+    // Points generated so far, over all calls
+    long long position = 0;
+
+    /*
+     * Points of worker t's stream among the first `points` output points
+     */
+    long long ownedBefore(int t, long long points) const {
+        long long round = SLICE_POINTS * threadCount();
+        long long within = points % round - t * SLICE_POINTS;
+        return points / round * SLICE_POINTS + std::min(std::max(within, 0LL), SLICE_POINTS);
+    }
+
+    /*
+     * Run work(t) for every worker, on its own thread when there is
+     * more than one
+     */
+    template <typename Work>
+    void runWorkers(Work work) {
+        int n = threadCount();
+        if (n == 1) {
+            work(0);
+            return;
+        }
+        std::vector<std::thread> workers;
+        for (int t = 0; t < n; t++) {
+            workers.push_back(std::thread(work, t));
+        }
+        for (size_t t = 0; t < workers.size(); t++) {
+            workers[t].join();
+        }
+    }
+};
+
+/*
+ * The three-vertex chaos game on ParallelChains
+ */
+template <typename Rng>
+class ParallelChaosGame : public ParallelChains<ChaosChain<Rng> > {
+public:
+    /*
+     * vertices: the three triangle corners
+     * seed:     base seed; chain t uses the stream after t jump()s
+     * threads:  number of worker threads / chains (at least 1)
+     * burnIn:   points each chain discards before its first output
+     * kernel:   SIMD kernel, KERNEL_AUTO for the widest supported one
+     */
+    ParallelChaosGame(const float (*vertices)[2], uint64_t seed,
+                      int threads, long long burnIn,
+                      ChaosKernelKind kernel = KERNEL_AUTO) {
+        if (threads < 1) threads = 1;
+        Rng rng(seed);
+        for (int t = 0; t < threads; t++) {
+            this->chains.push_back(ChaosChain<Rng>(rng, vertices, kernel));
+            this->chains.back().discard(burnIn);
+            rng.jump();
+        }
+    }
+};
+
+#endif // CHAOS_GAME_H
@@ -0,0 +1,256 @@
+/*
+ * chaos_kernels.h - SIMD kernels for the chaos game
+ *
+ * A kernel advances W independent chains ("lanes") at once, kept in
+ * structure-of-arrays form (all x in one register, all y in another):
+ *
+ *   x[l] = (x[l] + tableX[choice[l]]) * 0.5
+ *   y[l] = (y[l] + tableY[choice[l]]) * 0.5
+ *
+ * and stores the W new points interleaved as x, y pairs in lane order.
+ * Multiplying by 0.5 is exact, so every lane produces bit-identical
+ * results to the scalar (x + v) / 2 form.
+ *
+ * Choices and output are laid out in rows of `stride` lanes per step,
+ * of which a kernel handles W. Callers keep a fixed number of logical
+ * chains (CHAOS_MAX_LANES) and run narrower kernels over them in
+ * groups of W, so the output does not depend on which kernel runs.
+ *
+ * Vertex selection uses a register permute on the vertex table
+ * (AVX2 / AVX-512) or a compare-and-blend on the three entries (SSE2).
+ * The widest kernel the CPU supports is chosen at runtime; non-x86
+ * builds use the scalar kernel only.
+ */
+
+#ifndef CHAOS_KERNELS_H
+#define CHAOS_KERNELS_H
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define CHAOS_KERNELS_X86 1
+    #include <immintrin.h>
+#endif
+
+// Maximum number of lanes of any kernel (AVX-512: 16 floats)
+const int CHAOS_MAX_LANES = 16;
+
+enum ChaosKernelKind {
+    KERNEL_AUTO,
+    KERNEL_SCALAR,
+    KERNEL_SSE2,
+    KERNEL_AVX2,
+    KERNEL_AVX512
+};
+
+/*
+ * Kernel signature
+ *
+ * tableX, tableY: vertex coordinates, padded to CHAOS_MAX_LANES entries
+ * laneX, laneY:   current point of each lane (read and updated)
+ * choices:        steps rows of `stride` vertex indices (0..2); the
+ *                 kernel reads the first W of each row
+ * out:            steps rows of `stride` interleaved points; the kernel
+ *                 writes the first W of each row
+ */
+typedef void (*ChaosKernelFn)(const float* tableX, const float* tableY,
+                              float* laneX, float* laneY,
+                              const uint8_t* choices, float* out, long long steps,
+                              long long stride);
+
+/*
+ * Scalar kernel - one lane
+ */
+inline void chaosKernelScalar(const float* tableX, const float* tableY,
+                              float* laneX, float* laneY,
+                              const uint8_t* choices, float* out, long long steps,
+                              long long stride) {
+    float x = laneX[0];
+    float y = laneY[0];
+    for (long long i = 0; i < steps; i++) {
+        x = (x + tableX[choices[stride * i]]) * 0.5f;
+        y = (y + tableY[choices[stride * i]]) * 0.5f;
+        out[2 * stride * i] = x;
+        out[2 * stride * i + 1] = y;
+    }
+    laneX[0] = x;
+    laneY[0] = y;
+}
+
+#ifdef CHAOS_KERNELS_X86
+
+/*
+ * SSE2 kernel - 4 lanes, vertex selected by compare + blend
+ */
+__attribute__((target("sse2")))
+inline void chaosKernelSse2(const float* tableX, const float* tableY,
+                            float* laneX, float* laneY,
+                            const uint8_t* choices, float* out, long long steps,
+                            long long stride) {
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 vx0 = _mm_set1_ps(tableX[0]), vy0 = _mm_set1_ps(tableY[0]);
+    const __m128 vx1 = _mm_set1_ps(tableX[1]), vy1 = _mm_set1_ps(tableY[1]);
+    const __m128 vx2 = _mm_set1_ps(tableX[2]), vy2 = _mm_set1_ps(tableY[2]);
+    __m128 x = _mm_loadu_ps(laneX);
+    __m128 y = _mm_loadu_ps(laneY);
+    for (long long i = 0; i < steps; i++) {
+        int32_t packed;
+        std::memcpy(&packed, choices + stride * i, 4);
+        __m128i c = _mm_cvtsi32_si128(packed);
+        c = _mm_unpacklo_epi16(_mm_unpacklo_epi8(c, zero), zero);
+        __m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(c, zero));
+        __m128 is1 = _mm_castsi128_ps(_mm_cmpeq_epi32(c, one));
+        __m128 is2 = _mm_andnot_ps(_mm_or_ps(is0, is1), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+        __m128 vx = _mm_or_ps(_mm_or_ps(_mm_and_ps(is0, vx0), _mm_and_ps(is1, vx1)),
+                              _mm_and_ps(is2, vx2));
+        __m128 vy = _mm_or_ps(_mm_or_ps(_mm_and_ps(is0, vy0), _mm_and_ps(is1, vy1)),
+                              _mm_and_ps(is2, vy2));
+        x = _mm_mul_ps(_mm_add_ps(x, vx), half);
+        y = _mm_mul_ps(_mm_add_ps(y, vy), half);
+        _mm_storeu_ps(out + 2 * stride * i, _mm_unpacklo_ps(x, y));
+        _mm_storeu_ps(out + 2 * stride * i + 4, _mm_unpackhi_ps(x, y));
+    }
+    _mm_storeu_ps(laneX, x);
+    _mm_storeu_ps(laneY, y);
+}
+
+/*
+ * AVX2 kernel - 8 lanes, vertex selected by a permute of the table
+ */
+__attribute__((target("avx2")))
+inline void chaosKernelAvx2(const float* tableX, const float* tableY,
+                            float* laneX, float* laneY,
+                            const uint8_t* choices, float* out, long long steps,
+                            long long stride) {
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 tx = _mm256_loadu_ps(tableX);
+    const __m256 ty = _mm256_loadu_ps(tableY);
+    __m256 x = _mm256_loadu_ps(laneX);
+    __m256 y = _mm256_loadu_ps(laneY);
+    for (long long i = 0; i < steps; i++) {
+        __m256i c = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+            reinterpret_cast<const __m128i*>(choices + stride * i)));
+        x = _mm256_mul_ps(_mm256_add_ps(x, _mm256_permutevar8x32_ps(tx, c)), half);
+        y = _mm256_mul_ps(_mm256_add_ps(y, _mm256_permutevar8x32_ps(ty, c)), half);
+        // unpack gives x0 y0 x1 y1 | x4 y4 x5 y5 and x2 y2 x3 y3 | x6 y6 x7 y7
+        __m256 lo = _mm256_unpacklo_ps(x, y);
+        __m256 hi = _mm256_unpackhi_ps(x, y);
+        _mm256_storeu_ps(out + 2 * stride * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(out + 2 * stride * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    _mm256_storeu_ps(laneX, x);
+    _mm256_storeu_ps(laneY, y);
+}
+
+/*
+ * AVX-512 kernel - 16 lanes, vertex selected by a permute of the table
+ */
+__attribute__((target("avx512f")))
+inline void chaosKernelAvx512(const float* tableX, const float* tableY,
+                              float* laneX, float* laneY,
+                              const uint8_t* choices, float* out, long long steps,
+                              long long stride) {
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __mmask16 all = 0xFFFF;
+    const __m512 tx = _mm512_loadu_ps(tableX);
+    const __m512 ty = _mm512_loadu_ps(tableY);
+    // Reorder 128-bit blocks of the unpacked halves back into lane order
+    const __m512i first = _mm512_setr_epi32(0, 1, 2, 3, 16, 17, 18, 19,
+                                            4, 5, 6, 7, 20, 21, 22, 23);
+    const __m512i second = _mm512_setr_epi32(8, 9, 10, 11, 24, 25, 26, 27,
+                                             12, 13, 14, 15, 28, 29, 30, 31);
+    __m512 x = _mm512_loadu_ps(laneX);
+    __m512 y = _mm512_loadu_ps(laneY);
+    for (long long i = 0; i < steps; i++) {
+        // Zero-masked forms with a full mask are used because the plain
+        // ones trip -Wmaybe-uninitialized inside GCC 12's headers
+        __m512i c = _mm512_maskz_cvtepu8_epi32(all, _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(choices + stride * i)));
+        x = _mm512_mul_ps(_mm512_add_ps(x, _mm512_maskz_permutexvar_ps(all, c, tx)), half);
+        y = _mm512_mul_ps(_mm512_add_ps(y, _mm512_maskz_permutexvar_ps(all, c, ty)), half);
+        __m512 lo = _mm512_maskz_unpacklo_ps(all, x, y);
+        __m512 hi = _mm512_maskz_unpackhi_ps(all, x, y);
+        _mm512_storeu_ps(out + 2 * stride * i, _mm512_permutex2var_ps(lo, first, hi));
+        _mm512_storeu_ps(out + 2 * stride * i + 16, _mm512_permutex2var_ps(lo, second, hi));
+    }
+    _mm512_storeu_ps(laneX, x);
+    _mm512_storeu_ps(laneY, y);
+}
+
+#endif // CHAOS_KERNELS_X86
+
+/*
+ * Is the given kernel usable on this CPU?
+ */
+inline bool chaosKernelSupported(ChaosKernelKind kind) {
+    switch (kind) {
+        case KERNEL_AUTO:
+        case KERNEL_SCALAR:
+            return true;
+#ifdef CHAOS_KERNELS_X86
+        case KERNEL_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+        case KERNEL_AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+/*
+ * Resolve KERNEL_AUTO to the widest supported kernel
+ */
+inline ChaosKernelKind resolveChaosKernel(ChaosKernelKind kind) {
+    if (kind != KERNEL_AUTO) {
+        return kind;
+    }
+    const ChaosKernelKind preferred[] = {KERNEL_AVX512, KERNEL_AVX2, KERNEL_SSE2};
+    for (ChaosKernelKind k : preferred) {
+        if (chaosKernelSupported(k)) {
+            return k;
+        }
+    }
+    return KERNEL_SCALAR;
+}
+
+inline const char* chaosKernelName(ChaosKernelKind kind) {
+    switch (kind) {
+        case KERNEL_AUTO:   return "auto";
+        case KERNEL_SCALAR: return "scalar";
+        case KERNEL_SSE2:   return "sse2";
+        case KERNEL_AVX2:   return "avx2";
+        case KERNEL_AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+/*
+ * Number of lanes advanced per step by a (resolved) kernel
+ */
+inline int chaosKernelLanes(ChaosKernelKind kind) {
+    switch (kind) {
+        case KERNEL_SSE2:   return 4;
+        case KERNEL_AVX2:   return 8;
+        case KERNEL_AVX512: return 16;
+        default:            return 1;
+    }
+}
+
+inline ChaosKernelFn chaosKernelFunction(ChaosKernelKind kind) {
+    switch (kind) {
+#ifdef CHAOS_KERNELS_X86
+        case KERNEL_SSE2:   return chaosKernelSse2;
+        case KERNEL_AVX2:   return chaosKernelAvx2;
+        case KERNEL_AVX512: return chaosKernelAvx512;
+#endif
+        default:            return chaosKernelScalar;
+    }
+}
+
+#endif // CHAOS_KERNELS_H
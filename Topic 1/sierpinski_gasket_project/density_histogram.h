@@ -0,0 +1,106 @@
+/*
+ * density_histogram.h - 2D point-density accumulation
+ *
+ * Instead of drawing every chaos-game point, points are counted into
+ * a width x height grid of bins covering a rectangle of world space.
+ * Each worker thread fills its own histogram (no atomics or locks);
+ * the histograms are summed once at the end and tone mapped into a
+ * single RGBA image. The cost of displaying the result depends only
+ * on the resolution, not on how many points were generated.
+ */
+
+#ifndef DENSITY_HISTOGRAM_H
+#define DENSITY_HISTOGRAM_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+
+class DensityHistogram {
+public:
+    /*
+     * width, height:   number of bins
+     * minX..maxY:      world-space rectangle covered by the bins
+     */
+    DensityHistogram(int width = 1, int height = 1,
+                     float minX = -1.0f, float maxX = 1.0f,
+                     float minY = -1.0f, float maxY = 1.0f)
+        : width(width), height(height), minX(minX), minY(minY),
+          scaleX(width / (maxX - minX)), scaleY(height / (maxY - minY)),
+          counts(static_cast<size_t>(width) * height, 0) {}
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    const std::vector<uint32_t>& getCounts() const { return counts; }
+
+    void clear() {
+        std::fill(counts.begin(), counts.end(), 0u);
+    }
+
+    // Bin n interleaved points of `stride` floats by their x, y (3D
+    // points are projected along z); points outside the rectangle, and
+    // NaNs, are ignored. The range is checked before converting, as the
+    // conversion truncates toward zero (folding points just left of or
+    // below the rectangle into bin 0) and is undefined out of int range.
+    void add(const float* points, long long n, int stride = 2) {
+        const float fw = static_cast<float>(width);
+        const float fh = static_cast<float>(height);
+        for (long long i = 0; i < n; i++) {
+            float fx = (points[stride * i] - minX) * scaleX;
+            float fy = (points[stride * i + 1] - minY) * scaleY;
+            if (fx >= 0.0f && fx < fw && fy >= 0.0f && fy < fh) {
+                counts[static_cast<size_t>(fy) * width + static_cast<size_t>(fx)]++;
+            }
+        }
+    }
+
+    // Add another histogram of the same size into this one
+    void merge(const DensityHistogram& other) {
+        for (size_t i = 0; i < counts.size(); i++) {
+            counts[i] += other.counts[i];
+        }
+    }
+
+    uint32_t maxCount() const {
+        uint32_t m = 0;
+        for (size_t i = 0; i < counts.size(); i++) {
+            if (counts[i] > m) m = counts[i];
+        }
+        return m;
+    }
+
+    /*
+     * Log-density tone mapping into RGBA8, bottom row first (the row
+     * order glTexImage2D expects):
+     *
+     *   intensity = log(1 + count) / log(1 + maxCount)
+     *   pixel     = color * intensity
+     *
+     * The log curve keeps the sparse outer regions visible next to the
+     * heavily hit ones.
+     */
+    void toneMap(const float color[3], std::vector<uint8_t>& rgba) const {
+        rgba.resize(counts.size() * 4);
+        uint32_t peak = maxCount();
+        float norm = peak > 0 ? 1.0f / std::log1p(static_cast<float>(peak)) : 0.0f;
+        for (size_t i = 0; i < counts.size(); i++) {
+            float intensity = std::log1p(static_cast<float>(counts[i])) * norm;
+            for (int c = 0; c < 3; c++) {
+                rgba[4 * i + c] = static_cast<uint8_t>(255.0f * color[c] * intensity + 0.5f);
+            }
+            rgba[4 * i + 3] = 255;
+        }
+    }
+
+private:
+    int width;
+    int height;
+    float minX;
+    float minY;
+    float scaleX;
+    float scaleY;
+    std::vector<uint32_t> counts;
+};
+
+#endif // DENSITY_HISTOGRAM_H
@@ -9,13 +9,85 @@
  * - ESC: Exit the program
  * - R: Reset and regenerate with current parameters
  * - +/-: Increase/decrease number of iterations
+ * - H: Toggle density-histogram mode
+ * - V: Toggle vertex buffer / immediate mode drawing
+ * - F: Toggle the frame-time overlay
+ *
+ * Headless batch mode (no window, no GL context):
+ *   ./gasket_2d_random --headless --points 1000000000 --output points.bin
+ *   ./gasket_2d_random --headless --points 1e9 --output - | consumer
+ *
+ * Random vertex choices come from prng.h; pass --seed N for a
+ * reproducible run and --rng xoshiro|pcg to pick the generator.
+ * Points are generated by --threads independent chains in parallel
+ * (see chaos_game.h), each advancing several chains per SIMD
+ * instruction (see chaos_kernels.h; --kernel overrides the choice).
+ *
+ * Density-histogram mode (--histogram, or H in the window) bins the
+ * points into a per-thread 2D histogram and shows it as one texture
+ * with log-density tone mapping (see density_histogram.h). Headless
+ * histogram runs write the image as a PGM file:
+ *   ./gasket_2d_random --headless --histogram --resolution 2048x2048 \
+ *       --points 1e10 --output gasket.pgm
+ *
+ * In the window, points are generated progressively by the idle
+ * callback within a per-frame time budget (--frame-budget), and kept
+ * between frames so increasing the point count only adds new points.
+ *
+ * Benchmark of every kernel against the original rand() loop:
+ *   ./gasket_2d_random --bench --points 1e8
+ *
+ * --ifs NAME (gasket, carpet, fern, tetrahedron) or --ifs-file PATH
+ * replaces the three vertices by a general iterated function system:
+ * up to 16 affine maps in 2D or 3D with their own probabilities (see
+ * ifs_engine.h). Everything above works the same way; 3D systems are
+ * shown and binned as their x, y projection, and stream 3 floats per
+ * point. The view is fitted to the attractor.
+ *   ./gasket_2d_random --ifs fern --histogram
+ *
+ * Frame times (generation in idle(), GL submission, GPU time) are
+ * recorded by ../../common/frame_timer.h; --frame-csv PATH writes one
+ * row per frame.
+ *
+ * --offscreen generates all points first, then renders --frames N
+ * frames without a window and writes the last one with --image (see
+ * ../../common/offscreen.h). The seed defaults to 0 there, so the
+ * image is reproducible:
+ *   ./gasket_2d_random --offscreen --points 1e6 --frames 100 --image gasket.png
+ *
+ * Headless and offscreen runs append their results as one JSON line
+ * to --bench-json PATH (see ../../common/bench_report.h and bench.sh).
  */
 
-#include <GLUT/glut.h>
+#ifdef __APPLE__
+    #include <GLUT/glut.h>
+#else
+    #define GL_GLEXT_PROTOTYPES  // declare buffer object entry points
+    #include <GL/glut.h>
+#endif
 #include <iostream>
+#include <algorithm>
 #include <cstdlib>
 #include <ctime>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <limits>
+#include <string>
+#include <vector>
+#include <thread>
+#include <future>
+#include <memory>
+#include "prng.h"
+#include "chaos_game.h"
+#include "density_histogram.h"
+#include "ifs_engine.h"
+#include "vertex_buffer.h"
+#include "../../common/bench_report.h"
+#include "../../common/frame_timer.h"
+#include "../../common/offscreen.h"
 
 // Window dimensions
 const int WINDOW_WIDTH = 800;
@@ -31,12 +103,86 @@ float vertices[3][2] = {
     {0.0f, 0.9f}     // Top
 };
 
-// Current point position
-float currentPoint[2] = {0.0f, 0.0f};
-
 // Color scheme
 float pointColor[3] = {0.0f, 1.0f, 0.0f}; // Green
 
+// Random number generation (see prng.h)
+enum RngKind { RNG_XOSHIRO, RNG_PCG };
+RngKind rngKind = RNG_XOSHIRO;
+uint64_t rngSeed = 0;   // replaced by time(0) unless --seed is given
+
+// Parallel generation (see chaos_game.h)
+int numThreads = 0;        // 0 = one per hardware thread
+long long burnIn = 32;     // points discarded by each chain before output
+ChaosKernelKind kernelKind = KERNEL_AUTO;
+
+// Benchmark mode (--bench)
+bool benchMode = false;
+
+// General iterated function system in place of the three vertices
+// (--ifs NAME, --ifs-file PATH; see ifs_engine.h)
+bool ifsMode = false;
+const char* ifsName = "";
+IfsSystem ifsSystem;
+
+// World-space rectangle shown and binned, and the z range kept for 3D
+// systems; fitted to the attractor in IFS mode
+float viewMin[2] = {-1.0f, -1.0f};
+float viewMax[2] = {1.0f, 1.0f};
+float viewDepth = 1.0f;
+
+// Generated points, interleaved x, y
+std::vector<float> pointBuffer;
+
+// Points are drawn from a GPU vertex buffer with one glDrawArrays();
+// immediate mode (one glVertex call per point) is the fallback
+VertexBuffer pointVbo(2);
+bool useVertexBuffers = true;
+bool vertexBuffersAvailable = false;
+
+// Progressive rendering state - kept between frames so that only new
+// points are generated when numPoints grows
+std::unique_ptr<ChaosGenerator> liveGenerator;
+long long generatedPoints = 0;      // points accumulated so far
+double frameBudgetMs = 15.0;        // generation time per idle() call
+const long long PROGRESS_BATCH = 65536;   // points per thread between time checks
+
+// Frame-time statistics (F toggles the overlay)
+FrameTimer frameTimer;
+
+// Windowless rendering (--offscreen)
+OffscreenOptions offscreen;
+
+// Results of headless and offscreen runs (--bench-json)
+BenchReport benchReport;
+
+// Density-histogram mode (see density_histogram.h)
+bool histogramMode = false;
+int histogramWidth = 0;    // 0 = current window size
+int histogramHeight = 0;
+GLuint densityTexture = 0;
+std::vector<uint8_t> densityImage;   // tone-mapped RGBA8
+std::vector<DensityHistogram> liveHistograms;   // one per worker thread
+bool densityDirty = false;           // texture needs rebuilding
+
+// Headless batch mode settings (set from the command line)
+bool headlessMode = false;
+long long headlessPoints = 1000000;
+const char* outputPath = "-";          // "-" streams to stdout
+long long chunkPoints = 1 << 20;       // points per fwrite()
+const double MAX_COUNT = 9007199254740992.0;    // 2^53, for --points and --chunk
+
+// Header written once at the start of every binary point stream.
+// It is followed by pointCount records of float[dimensions] in
+// native byte order (little-endian on every supported platform).
+struct PointStreamHeader {
+    char magic[4];          // "SGPT"
+    uint32_t dimensions;    // 2, or 3 for a 3D system
+    uint64_t pointCount;    // number of records that follow
+};
+
+void idle();
+
 /*
  * Initialize OpenGL settings
  */
@@ -44,14 +190,28 @@ void init() {
     glClearColor(0.0, 0.0, 0.0, 1.0);  // Black background
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
-    gluOrtho2D(-1.0, 1.0, -1.0, 1.0);
+    glOrtho(viewMin[0], viewMax[0], viewMin[1], viewMax[1], -viewDepth, viewDepth);
+    
+    // Texture that receives the tone-mapped density histogram
+    glGenTextures(1, &densityTexture);
+    glBindTexture(GL_TEXTURE_2D, densityTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     
-    // Initialize random seed
-    srand(static_cast<unsigned>(time(0)));
+    vertexBuffersAvailable = VertexBuffer::supported();
+    if (!vertexBuffersAvailable) {
+        useVertexBuffers = false;
+        std::cout << "Vertex buffers not supported, using immediate mode" << std::endl;
+    }
     
     std::cout << "=== Sierpinski Gasket - 2D Random Point Method ===" << std::endl;
     std::cout << "Current points: " << numPoints << std::endl;
-    std::cout << "Controls: +/- to adjust points, R to reset, ESC to exit" << std::endl;
+    std::cout << "Random seed: " << rngSeed << std::endl;
+    std::cout << "Controls: +/- to adjust points, R to reset, H for histogram, "
+              << "V for vertex buffer/immediate, F for frame times, ESC to exit" << std::endl;
 }
 
 /*
@@ -62,6 +222,210 @@ void calculateMidpoint(float p1[2], float p2[2], float result[2]) {
     result[1] = (p1[1] + p2[1]) / 2.0f;
 }
 
+/*
+ * Floats per generated point
+ */
+int pointDimensions() {
+    return ifsMode ? ifsSystem.dimensions : 2;
+}
+
+/*
+ * Name of the kernel the generator runs
+ */
+const char* kernelInUse() {
+    return chaosKernelName(ifsMode ? resolveIfsKernel(kernelKind, ifsSystem.mapCount())
+                                   : resolveChaosKernel(kernelKind));
+}
+
+/*
+ * Fit the view to the attractor of ifsSystem: its bounding box plus a
+ * margin, widened to a square so the shape is not stretched. Returns
+ * false if the bounds are not finite.
+ */
+bool fitViewToSystem() {
+    float lower[3], upper[3];
+    ifsBounds(ifsSystem, lower, upper);
+    for (int d = 0; d < ifsSystem.dimensions; d++) {
+        if (!std::isfinite(upper[d] - lower[d])) {
+            return false;
+        }
+    }
+    float size = std::max(upper[0] - lower[0], upper[1] - lower[1]) * 1.05f;
+    for (int d = 0; d < 2; d++) {
+        float center = (lower[d] + upper[d]) / 2.0f;
+        viewMin[d] = center - size / 2.0f;
+        viewMax[d] = center + size / 2.0f;
+    }
+    if (ifsSystem.dimensions == 3) {
+        viewDepth = std::max(std::fabs(lower[2]), std::fabs(upper[2])) + 1.0f;
+    }
+    return true;
+}
+
+/*
+ * Create the generator of ifsSystem for the current seed and settings
+ */
+template <typename Rng>
+std::unique_ptr<ChaosGenerator> createIfsGenerator() {
+    if (ifsSystem.dimensions == 3) {
+        return std::unique_ptr<ChaosGenerator>(
+            new ParallelIfs<Rng, 3>(ifsSystem, rngSeed, numThreads, burnIn, kernelKind));
+    }
+    return std::unique_ptr<ChaosGenerator>(
+        new ParallelIfs<Rng, 2>(ifsSystem, rngSeed, numThreads, burnIn, kernelKind));
+}
+
+/*
+ * Create a chaos-game generator for the current seed and settings
+ */
+std::unique_ptr<ChaosGenerator> createGenerator() {
+    if (ifsMode) {
+        return rngKind == RNG_PCG ? createIfsGenerator<Pcg32>() : createIfsGenerator<Xoshiro256>();
+    }
+    if (rngKind == RNG_PCG) {
+        return std::unique_ptr<ChaosGenerator>(
+            new ParallelChaosGame<Pcg32>(vertices, rngSeed, numThreads, burnIn, kernelKind));
+    }
+    return std::unique_ptr<ChaosGenerator>(
+        new ParallelChaosGame<Xoshiro256>(vertices, rngSeed, numThreads, burnIn, kernelKind));
+}
+
+/*
+ * Bin count more points from game into its per-thread histograms.
+ * Each worker only touches perThread[t], so no locking is needed.
+ */
+void accumulateDensity(ChaosGenerator& game, std::vector<DensityHistogram>& perThread,
+                       long long count) {
+    int dimensions = game.dimensions();
+    game.consume(count, [&perThread, dimensions](int t, const float* points, long long n) {
+        perThread[t].add(points, n, dimensions);
+    });
+}
+
+/*
+ * Sum per-thread histograms into a single one
+ */
+DensityHistogram mergeDensity(const std::vector<DensityHistogram>& perThread) {
+    DensityHistogram total = perThread[0];
+    for (size_t t = 1; t < perThread.size(); t++) {
+        total.merge(perThread[t]);
+    }
+    return total;
+}
+
+/*
+ * Discard everything generated so far and start a new generator;
+ * histograms are sized width x height
+ */
+void resetGenerator(int width, int height) {
+    liveGenerator = createGenerator();
+    generatedPoints = 0;
+    pointBuffer.clear();
+    pointVbo.clear();
+    liveHistograms.clear();
+    if (histogramMode) {
+        if (histogramWidth > 0) {
+            width = histogramWidth;
+            height = histogramHeight;
+        }
+        liveHistograms.assign(liveGenerator->threadCount(),
+                              DensityHistogram(width, height, viewMin[0], viewMax[0],
+                                               viewMin[1], viewMax[1]));
+    }
+    densityDirty = true;
+}
+
+/*
+ * Start over: new generator, nothing accumulated. The idle callback
+ * then rebuilds the picture progressively.
+ */
+void resetProgress() {
+    resetGenerator(glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
+    glutIdleFunc(idle);
+    glutPostRedisplay();
+}
+
+/*
+ * Generate points toward numPoints for at most budgetMs
+ */
+void generateProgress(double budgetMs) {
+    frameTimer.beginGeneration();
+    auto start = std::chrono::steady_clock::now();
+    long long batch = PROGRESS_BATCH * liveGenerator->threadCount();
+    double elapsedMs = 0.0;
+    while (generatedPoints < numPoints && elapsedMs < budgetMs) {
+        long long n = numPoints - generatedPoints;
+        if (n > batch) n = batch;
+        if (histogramMode) {
+            accumulateDensity(*liveGenerator, liveHistograms, n);
+        } else {
+            int dimensions = pointDimensions();
+            pointBuffer.resize(static_cast<size_t>(generatedPoints + n) * dimensions);
+            liveGenerator->generate(&pointBuffer[dimensions * generatedPoints], n);
+            if (useVertexBuffers) {
+                // Upload only the new points
+                pointVbo.update(pointBuffer.data(), static_cast<GLsizei>(generatedPoints),
+                                static_cast<GLsizei>(n));
+            }
+        }
+        generatedPoints += n;
+        elapsedMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+    densityDirty = histogramMode;
+    frameTimer.endGeneration();
+    
+    if (generatedPoints >= numPoints) {
+        std::cout << "Generated " << generatedPoints << " points" << std::endl;
+    }
+}
+
+/*
+ * Idle callback - progressive generation
+ *
+ * Generates points toward numPoints for at most frameBudgetMs, then
+ * redraws whatever has accumulated so far. Keeping the chains and the
+ * accumulated points between frames means growing numPoints only costs
+ * the new points. The callback unregisters itself once caught up.
+ */
+void idle() {
+    if (generatedPoints >= numPoints) {
+        glutIdleFunc(NULL);
+        return;
+    }
+    generateProgress(frameBudgetMs);
+    glutPostRedisplay();
+}
+
+/*
+ * Draw the accumulated density as a tone-mapped texture on a
+ * full-view quad. The texture is only rebuilt when new points have
+ * been binned since the last frame.
+ */
+void drawDensity() {
+    if (liveHistograms.empty()) {
+        return;
+    }
+    glBindTexture(GL_TEXTURE_2D, densityTexture);
+    if (densityDirty) {
+        DensityHistogram histogram = mergeDensity(liveHistograms);
+        histogram.toneMap(pointColor, densityImage);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, histogram.getWidth(), histogram.getHeight(), 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, densityImage.data());
+        densityDirty = false;
+    }
+    
+    glEnable(GL_TEXTURE_2D);
+    glColor3f(1.0f, 1.0f, 1.0f);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, 0.0f); glVertex2f(viewMin[0], viewMin[1]);
+    glTexCoord2f(1.0f, 0.0f); glVertex2f(viewMax[0], viewMin[1]);
+    glTexCoord2f(1.0f, 1.0f); glVertex2f(viewMax[0], viewMax[1]);
+    glTexCoord2f(0.0f, 1.0f); glVertex2f(viewMin[0], viewMax[1]);
+    glEnd();
+    glDisable(GL_TEXTURE_2D);
+}
+
 /*
  * Display callback - renders the Sierpinski Gasket
  * 
@@ -71,46 +435,63 @@ void calculateMidpoint(float p1[2], float p2[2], float result[2]) {
  * 3. Plot the midpoint between current point and selected vertex
  * 4. Make this midpoint the new current point
  * 5. Repeat steps 2-4 for the specified number of iterations
+ *
+ * Points are generated by idle(); display() only draws the points
+ * accumulated so far.
  */
 void display() {
+    frameTimer.beginFrame();
+    frameTimer.beginSubmission();
     glClear(GL_COLOR_BUFFER_BIT);
     
-    // Draw the initial triangle vertices (for reference)
-    glColor3f(1.0f, 0.0f, 0.0f);  // Red
-    glPointSize(5.0f);
-    glBegin(GL_POINTS);
-    for (int i = 0; i < 3; i++) {
-        glVertex2fv(vertices[i]);
+    if (histogramMode) {
+        drawDensity();
     }
-    glEnd();
-    
-    // Initialize starting point at the center
-    currentPoint[0] = 0.0f;
-    currentPoint[1] = 0.0f;
     
-    // Generate the gasket points
-    glColor3fv(pointColor);
-    glPointSize(1.0f);
-    glBegin(GL_POINTS);
+    // Draw the initial triangle vertices (for reference)
+    if (!ifsMode) {
+        glColor3f(1.0f, 0.0f, 0.0f);  // Red
+        glPointSize(5.0f);
+        glBegin(GL_POINTS);
+        for (int i = 0; i < 3; i++) {
+            glVertex2fv(vertices[i]);
+        }
+        glEnd();
+    }
     
-    for (int i = 0; i < numPoints; i++) {
-        // Randomly select one of the three vertices
-        int randomVertex = rand() % 3;
-        
-        // Calculate midpoint between current point and selected vertex
-        float midpoint[2];
-        calculateMidpoint(currentPoint, vertices[randomVertex], midpoint);
-        
-        // Plot the midpoint
-        glVertex2fv(midpoint);
-        
-        // Update current point
-        currentPoint[0] = midpoint[0];
-        currentPoint[1] = midpoint[1];
+    if (!histogramMode) {
+        // Plot the gasket points (fewer than generated after '-')
+        long long visible = generatedPoints < numPoints ? generatedPoints : numPoints;
+        glColor3fv(pointColor);
+        glPointSize(1.0f);
+        if (useVertexBuffers) {
+            pointVbo.draw(GL_POINTS, 0, static_cast<GLsizei>(visible));
+        } else {
+            int dimensions = pointDimensions();
+            glBegin(GL_POINTS);
+            for (long long i = 0; i < visible; i++) {
+                glVertex2fv(&pointBuffer[dimensions * i]);
+            }
+            glEnd();
+        }
     }
     
-    glEnd();
-    glFlush();
+    frameTimer.endSubmission();
+    frameTimer.endFrame();
+    if (!offscreen.enabled) {
+        glutSwapBuffers();
+    }
+}
+
+/*
+ * Window reshape callback
+ */
+void reshape(int w, int h) {
+    glViewport(0, 0, w, h);
+    // A histogram that follows the window size must be rebuilt
+    if (histogramMode && histogramWidth == 0) {
+        resetProgress();
+    }
 }
 
 /*
@@ -125,6 +506,8 @@ void keyboard(unsigned char key, int x, int y) {
         case '=':
             numPoints += 5000;
             std::cout << "Points increased to: " << numPoints << std::endl;
+            // Only the new points need generating
+            glutIdleFunc(idle);
             glutPostRedisplay();
             break;
         case '-':
@@ -132,23 +515,530 @@ void keyboard(unsigned char key, int x, int y) {
             if (numPoints > 5000) {
                 numPoints -= 5000;
                 std::cout << "Points decreased to: " << numPoints << std::endl;
-                glutPostRedisplay();
+                if (histogramMode) {
+                    // Binned points cannot be removed again
+                    resetProgress();
+                } else {
+                    glutPostRedisplay();
+                }
             }
             break;
         case 'r':
         case 'R':
-            std::cout << "Regenerating gasket..." << std::endl;
+            rngSeed++;
+            std::cout << "Regenerating gasket with seed " << rngSeed << "..." << std::endl;
+            resetProgress();
+            break;
+        case 'h':
+        case 'H':
+            histogramMode = !histogramMode;
+            std::cout << "Mode: " << (histogramMode ? "Density histogram" : "Points") << std::endl;
+            resetProgress();
+            break;
+        case 'v':
+        case 'V':
+            if (!vertexBuffersAvailable) {
+                std::cout << "Vertex buffers not supported" << std::endl;
+                break;
+            }
+            useVertexBuffers = !useVertexBuffers;
+            // Histogram mode keeps no points, only the density image
+            if (useVertexBuffers && !histogramMode) {
+                pointVbo.clear();
+                pointVbo.update(pointBuffer.data(), 0, static_cast<GLsizei>(generatedPoints));
+            }
+            std::cout << "Drawing: " << (useVertexBuffers ? "Vertex buffer" : "Immediate mode") << std::endl;
             glutPostRedisplay();
             break;
+        case 'f':
+        case 'F':
+            frameTimer.toggleOverlay();
+            glutPostRedisplay();
+            break;
+    }
+}
+
+/*
+ * Stream headlessPoints points to out, chunkPoints at a time.
+ * Returns false if a write fails.
+ *
+ * Two chunk buffers are used so the workers generate chunk k+1 while
+ * chunk k is being written.
+ */
+bool streamChaosPoints(FILE* out) {
+    std::unique_ptr<ChaosGenerator> game = createGenerator();
+    int dimensions = game->dimensions();
+    std::vector<float> chunks[2];
+    chunks[0].resize(static_cast<size_t>(chunkPoints) * dimensions);
+    chunks[1].resize(static_cast<size_t>(chunkPoints) * dimensions);
+
+    long long written = 0;
+    long long pending = 0;   // points waiting in chunks[current]
+    int current = 0;
+    while (written < headlessPoints) {
+        long long next = headlessPoints - written - pending;
+        if (next > chunkPoints) next = chunkPoints;
+
+        std::future<size_t> writer;
+        if (pending > 0) {
+            const float* data = chunks[current].data();
+            long long n = pending;
+            writer = std::async(std::launch::async, [data, n, dimensions, out]() {
+                return std::fwrite(data, dimensions * sizeof(float), n, out);
+            });
+        }
+        if (next > 0) {
+            game->generate(chunks[1 - current].data(), next);
+        }
+        if (pending > 0) {
+            if (writer.get() != static_cast<size_t>(pending)) {
+                std::cerr << "Error: write failed after " << written
+                          << " points" << std::endl;
+                return false;
+            }
+            written += pending;
+        }
+        pending = next;
+        current = 1 - current;
+    }
+    return true;
+}
+
+/*
+ * Headless histogram - accumulate headlessPoints into a density
+ * histogram and write it as an 8-bit binary PGM (top row first)
+ */
+bool writeDensityImage(FILE* out) {
+    int width = histogramWidth > 0 ? histogramWidth : WINDOW_WIDTH;
+    int height = histogramHeight > 0 ? histogramHeight : WINDOW_HEIGHT;
+    
+    std::unique_ptr<ChaosGenerator> game = createGenerator();
+    std::vector<DensityHistogram> perThread(game->threadCount(),
+                                            DensityHistogram(width, height, viewMin[0], viewMax[0],
+                                                             viewMin[1], viewMax[1]));
+    accumulateDensity(*game, perThread, headlessPoints);
+    DensityHistogram histogram = mergeDensity(perThread);
+    const float white[3] = {1.0f, 1.0f, 1.0f};
+    histogram.toneMap(white, densityImage);
+    
+    if (std::fprintf(out, "P5\n%d %d\n255\n", width, height) < 0) {
+        std::cerr << "Error: write failed" << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> row(width);
+    for (int y = height - 1; y >= 0; y--) {
+        for (int x = 0; x < width; x++) {
+            row[x] = densityImage[4 * (static_cast<size_t>(y) * width + x)];
+        }
+        if (std::fwrite(row.data(), 1, width, out) != static_cast<size_t>(width)) {
+            std::cerr << "Error: write failed" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Headless batch mode - streams chaos-game points without a window
+ *
+ * Points are generated chunkPoints at a time into a reusable buffer
+ * and written with a single fwrite() per chunk, so memory use stays
+ * constant no matter how many points are requested.
+ */
+int runHeadless() {
+    bool toStdout = std::strcmp(outputPath, "-") == 0;
+    FILE* out = toStdout ? stdout : std::fopen(outputPath, "wb");
+    if (out == NULL) {
+        std::cerr << "Error: cannot open output file " << outputPath << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool ok;
+    if (histogramMode) {
+        ok = writeDensityImage(out);
+    } else {
+        PointStreamHeader header = {{'S', 'G', 'P', 'T'}, static_cast<uint32_t>(pointDimensions()),
+                                    static_cast<uint64_t>(headlessPoints)};
+        if (std::fwrite(&header, sizeof(header), 1, out) != 1) {
+            std::cerr << "Error: write failed" << std::endl;
+            ok = false;
+        } else {
+            ok = streamChaosPoints(out);
+        }
+    }
+    // Buffered writes only fail here, e.g. on a full disk
+    bool flushed = std::fflush(out) == 0;
+    if (!toStdout) flushed = std::fclose(out) == 0 && flushed;
+    if (ok && !flushed) {
+        std::cerr << "Error: write failed" << std::endl;
+        ok = false;
+    }
+    if (!ok) {
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    // Progress goes to stderr so stdout can carry the point stream
+    std::cerr << "Wrote " << headlessPoints << (histogramMode ? " binned points to " : " points to ")
+              << (toStdout ? "stdout" : outputPath) << " (seed " << rngSeed
+              << ", " << numThreads << " threads, "
+              << kernelInUse() << ") in " << seconds << " s ("
+              << (seconds > 0.0 ? headlessPoints / seconds / 1.0e6 : 0.0)
+              << " Mpoints/s)" << std::endl;
+
+    benchReport.addString("program", "gasket_2d_random");
+    benchReport.addString("mode", "headless");
+    benchReport.addString("ifs", ifsMode ? ifsName : "none");
+    benchReport.addInteger("points", headlessPoints);
+    benchReport.addBool("histogram", histogramMode);
+    benchReport.addInteger("threads", numThreads);
+    benchReport.addString("kernel", kernelInUse());
+    benchReport.addNumber("generation_ms", seconds * 1000.0);
+    benchReport.addRate("points_per_second", static_cast<double>(headlessPoints), seconds * 1000.0);
+    benchReport.addPeakMemory();
+    return benchReport.write() ? 0 : 1;
+}
+
+/*
+ * The original display() loop - rand() % 3 and calculateMidpoint()
+ * per point - kept as the baseline for --bench
+ */
+void legacyChaosPoints(float* out, long long count) {
+    float current[2] = {0.0f, 0.0f};
+    for (long long i = 0; i < count; i++) {
+        int randomVertex = rand() % 3;
+        calculateMidpoint(current, vertices[randomVertex], current);
+        out[2 * i] = current[0];
+        out[2 * i + 1] = current[1];
+    }
+}
+
+/*
+ * Benchmark of an IFS - points/second of every kernel that can run it,
+ * and of the three-vertex game for comparison
+ */
+int runIfsBenchmark() {
+    std::vector<float> chunk(static_cast<size_t>(chunkPoints) * ifsSystem.dimensions);
+    std::cout << "IFS benchmark (" << ifsName << ", " << ifsSystem.mapCount() << " maps, "
+              << ifsSystem.dimensions << "D): " << headlessPoints << " points, chunk "
+              << chunkPoints << ", " << numThreads << " threads" << std::endl;
+    const ChaosKernelKind kinds[] = {KERNEL_AUTO, KERNEL_SCALAR, KERNEL_AVX2, KERNEL_AVX512};
+    // kinds[0] stands in for the three-vertex game
+    for (ChaosKernelKind kind : kinds) {
+        bool classic = (kind == KERNEL_AUTO);
+        if (!classic && !ifsKernelSupported(kind, ifsSystem.mapCount())) {
+            std::cout << "  " << chaosKernelName(kind) << ": not supported" << std::endl;
+            continue;
+        }
+        std::unique_ptr<ChaosGenerator> game;
+        if (classic) {
+            game.reset(new ParallelChaosGame<Xoshiro256>(vertices, rngSeed, numThreads, burnIn));
+        } else if (ifsSystem.dimensions == 3) {
+            game.reset(new ParallelIfs<Xoshiro256, 3>(ifsSystem, rngSeed, numThreads, burnIn, kind));
+        } else {
+            game.reset(new ParallelIfs<Xoshiro256, 2>(ifsSystem, rngSeed, numThreads, burnIn, kind));
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (long long done = 0; done < headlessPoints; done += chunkPoints) {
+            long long n = headlessPoints - done < chunkPoints ? headlessPoints - done : chunkPoints;
+            game->generate(chunk.data(), n);
+        }
+        double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        double rate = seconds > 0.0 ? headlessPoints / seconds : 0.0;
+        std::cout << "  " << (classic ? "three-vertex game" : chaosKernelName(kind))
+                  << ": " << rate / 1.0e6 << " Mpoints/s" << std::endl;
+    }
+    return 0;
+}
+
+/*
+ * Benchmark mode - points/second of the original loop and of every
+ * supported kernel, generating into a chunk buffer (nothing written)
+ */
+int runBenchmark() {
+    if (ifsMode) {
+        return runIfsBenchmark();
+    }
+    std::vector<float> chunk(static_cast<size_t>(chunkPoints) * 2);
+    srand(static_cast<unsigned>(rngSeed));
+
+    std::cout << "Chaos game benchmark: " << headlessPoints << " points, chunk "
+              << chunkPoints << ", " << numThreads << " threads" << std::endl;
+    double baseline = 0.0;
+    const ChaosKernelKind kinds[] = {KERNEL_AUTO, KERNEL_SCALAR, KERNEL_SSE2,
+                                     KERNEL_AVX2, KERNEL_AVX512};
+    // kinds[0] stands in for the legacy loop
+    for (ChaosKernelKind kind : kinds) {
+        bool legacy = (kind == KERNEL_AUTO);
+        if (!chaosKernelSupported(kind)) {
+            std::cout << "  " << chaosKernelName(kind) << ": not supported" << std::endl;
+            continue;
+        }
+        ParallelChaosGame<Xoshiro256> game(vertices, rngSeed,
+                                           legacy ? 1 : numThreads, burnIn, kind);
+        auto start = std::chrono::steady_clock::now();
+        for (long long done = 0; done < headlessPoints; done += chunkPoints) {
+            long long n = headlessPoints - done < chunkPoints ? headlessPoints - done : chunkPoints;
+            if (legacy) {
+                legacyChaosPoints(chunk.data(), n);
+            } else {
+                game.generate(chunk.data(), n);
+            }
+        }
+        double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        double rate = seconds > 0.0 ? headlessPoints / seconds : 0.0;
+        if (legacy) baseline = rate;
+        std::cout << "  " << (legacy ? "rand() loop" : chaosKernelName(kind))
+                  << ": " << rate / 1.0e6 << " Mpoints/s";
+        if (!legacy && baseline > 0.0) {
+            std::cout << " (" << rate / baseline << "x)";
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
+
+/*
+ * Offscreen mode: generate all numPoints points, then draw them
+ * --frames times into an offscreen framebuffer, with no window
+ */
+int runOffscreen() {
+    offscreen.defaultSize(WINDOW_WIDTH, WINDOW_HEIGHT);
+    int status = renderOffscreen(offscreen, frameTimer, false, []() {
+        init();
+        resetGenerator(offscreen.width, offscreen.height);
+        generateProgress(std::numeric_limits<double>::infinity());
+    }, display);
+    if (status != 0) {
+        return status;
+    }
+
+    // The generation before the first frame is counted in that frame
+    benchReport.addString("program", "gasket_2d_random");
+    benchReport.addString("mode", "offscreen");
+    benchReport.addString("ifs", ifsMode ? ifsName : "none");
+    benchReport.addInteger("points", generatedPoints);
+    benchReport.addBool("histogram", histogramMode);
+    benchReport.addBool("vertex_buffers", useVertexBuffers);
+    benchReport.addInteger("threads", numThreads);
+    benchReport.addString("kernel", kernelInUse());
+    benchReport.addInteger("width", offscreen.width);
+    benchReport.addInteger("height", offscreen.height);
+    benchReport.addFrameTimes(frameTimer);
+    benchReport.addRate("points_per_second", static_cast<double>(generatedPoints),
+                        frameTimer.stats(FrameTimer::GENERATION).total);
+    benchReport.addPeakMemory();
+    return benchReport.write() ? 0 : 1;
+}
+
+/*
+ * Print command line usage
+ */
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]" << std::endl;
+    std::cout << "  --headless        Generate points without opening a window" << std::endl;
+    std::cout << "  --points N        Number of points (default " << numPoints
+              << " interactive, " << headlessPoints << " headless)" << std::endl;
+    std::cout << "  --output PATH     Binary output file, '-' for stdout (default -)" << std::endl;
+    std::cout << "  --chunk N         Points buffered per write (default " << chunkPoints << ")" << std::endl;
+    std::cout << "  --seed N          Random seed for a reproducible run (default: time)" << std::endl;
+    std::cout << "  --rng NAME        Generator: xoshiro (default) or pcg" << std::endl;
+    std::cout << "  --threads N       Worker threads / independent chains (default: all cores)" << std::endl;
+    std::cout << "  --burn-in N       Points each chain discards first (default " << burnIn << ")" << std::endl;
+    std::cout << "  --kernel NAME     auto (default), scalar, sse2, avx2 or avx512" << std::endl;
+    std::cout << "  --bench           Measure points/second of every kernel" << std::endl;
+    std::cout << "  --ifs NAME        Run a built-in IFS: " << IFS_PRESET_NAMES << std::endl;
+    std::cout << "  --ifs-file PATH   Run the IFS in PATH (see ifs_engine.h)" << std::endl;
+    std::cout << "  --histogram       Accumulate a density histogram (headless: write PGM)" << std::endl;
+    std::cout << "  --resolution WxH  Histogram size (default: window size)" << std::endl;
+    std::cout << "  --immediate       Draw with glBegin/glEnd instead of a vertex buffer" << std::endl;
+    std::cout << "  --frame-budget MS Generation time per frame in the window (default "
+              << frameBudgetMs << ")" << std::endl;
+    std::cout << "  --frame-csv PATH  Write per-frame times as CSV" << std::endl;
+    std::cout << "  --offscreen       Render --frames N frames without a window" << std::endl;
+    std::cout << "  --frames N        Offscreen frames to render (default " << offscreen.frames << ")" << std::endl;
+    std::cout << "  --image PATH      Write the last offscreen frame (.png or .ppm)" << std::endl;
+    std::cout << "  --size WxH        Offscreen framebuffer size (default: window size)" << std::endl;
+    std::cout << "  --bench-json PATH Append headless/offscreen results to PATH as JSON" << std::endl;
+}
+
+/*
+ * Parse a point count: a whole number from 0 to MAX_COUNT, written
+ * either way strtod accepts (1000000000 or 1e9). Returns false for
+ * anything else, including trailing text, NaN and infinity.
+ */
+bool parseCount(const char* text, long long& count) {
+    char* end;
+    double value = std::strtod(text, &end);
+    if (end == text || *end != '\0' || !(value >= 0.0 && value <= MAX_COUNT) ||
+        value != std::floor(value)) {
+        return false;
+    }
+    count = static_cast<long long>(value);
+    return true;
+}
+
+/*
+ * Parse command line options
+ *
+ * Unrecognized arguments are left alone so GLUT can still consume
+ * its own options (e.g. -display) in interactive mode.
+ * Returns false on an invalid option; --help exits with status 0.
+ */
+bool parseArguments(int argc, char** argv) {
+    long long requestedPoints = -1;
+    bool seedGiven = false;
+    for (int i = 1; i < argc; i++) {
+        if (offscreen.parse(argc, argv, i) || benchReport.parse(argc, argv, i)) {
+            continue;
+        }
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            headlessMode = true;
+        } else if (std::strcmp(argv[i], "--points") == 0 && hasValue) {
+            if (!parseCount(argv[++i], requestedPoints)) {
+                std::cerr << "Error: --points expects a whole number from 0 to 2^53" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--output") == 0 && hasValue) {
+            outputPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--chunk") == 0 && hasValue) {
+            if (!parseCount(argv[++i], chunkPoints)) {
+                std::cerr << "Error: --chunk expects a whole number from 1 to 2^53" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--seed") == 0 && hasValue) {
+            rngSeed = std::strtoull(argv[++i], NULL, 10);
+            seedGiven = true;
+        } else if (std::strcmp(argv[i], "--rng") == 0 && hasValue) {
+            const char* name = argv[++i];
+            if (std::strcmp(name, "pcg") == 0) {
+                rngKind = RNG_PCG;
+            } else if (std::strcmp(name, "xoshiro") == 0) {
+                rngKind = RNG_XOSHIRO;
+            } else {
+                std::cerr << "Error: unknown generator '" << name << "'" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+            numThreads = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--burn-in") == 0 && hasValue) {
+            burnIn = std::atoll(argv[++i]);
+        } else if (std::strcmp(argv[i], "--kernel") == 0 && hasValue) {
+            const char* name = argv[++i];
+            const ChaosKernelKind kinds[] = {KERNEL_AUTO, KERNEL_SCALAR, KERNEL_SSE2,
+                                             KERNEL_AVX2, KERNEL_AVX512};
+            bool found = false;
+            for (ChaosKernelKind kind : kinds) {
+                if (std::strcmp(name, chaosKernelName(kind)) == 0) {
+                    kernelKind = kind;
+                    found = true;
+                }
+            }
+            if (!found || !chaosKernelSupported(kernelKind)) {
+                std::cerr << "Error: kernel '" << name << "' is unknown or not supported" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--ifs") == 0 && hasValue) {
+            ifsName = argv[++i];
+            if (!ifsPreset(ifsName, ifsSystem)) {
+                std::cerr << "Error: unknown IFS '" << ifsName << "' (built in: "
+                          << IFS_PRESET_NAMES << ")" << std::endl;
+                return false;
+            }
+            ifsMode = true;
+        } else if (std::strcmp(argv[i], "--ifs-file") == 0 && hasValue) {
+            ifsName = argv[++i];
+            std::string error;
+            if (!loadIfsFile(ifsName, ifsSystem, error)) {
+                std::cerr << "Error: " << ifsName << ": " << error << std::endl;
+                return false;
+            }
+            ifsMode = true;
+        } else if (std::strcmp(argv[i], "--histogram") == 0) {
+            histogramMode = true;
+        } else if (std::strcmp(argv[i], "--resolution") == 0 && hasValue) {
+            if (std::sscanf(argv[++i], "%dx%d", &histogramWidth, &histogramHeight) != 2 ||
+                histogramWidth < 1 || histogramHeight < 1) {
+                std::cerr << "Error: --resolution expects WIDTHxHEIGHT" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--immediate") == 0) {
+            useVertexBuffers = false;
+        } else if (std::strcmp(argv[i], "--frame-budget") == 0 && hasValue) {
+            frameBudgetMs = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--frame-csv") == 0 && hasValue) {
+            const char* path = argv[++i];
+            if (!frameTimer.openCsv(path)) {
+                std::cerr << "Error: cannot write " << path << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--bench") == 0) {
+            benchMode = true;
+        } else if (std::strcmp(argv[i], "--help") == 0) {
+            // Asked for, so not an error
+            printUsage(argv[0]);
+            std::exit(0);
+        }
+    }
+    if (!seedGiven && !offscreen.enabled) {
+        rngSeed = static_cast<uint64_t>(time(0));
+    }
+    if (numThreads <= 0) {
+        numThreads = static_cast<int>(std::thread::hardware_concurrency());
+        if (numThreads < 1) numThreads = 1;
+    }
+    if (chunkPoints < 1) {
+        std::cerr << "Error: --chunk must be at least 1" << std::endl;
+        return false;
+    }
+    if (ifsMode) {
+        if (!ifsKernelSupported(kernelKind, ifsSystem.mapCount())) {
+            std::cerr << "Error: kernel '" << chaosKernelName(kernelKind) << "' cannot run "
+                      << ifsSystem.mapCount() << " maps (IFS kernels: scalar, avx2 up to 8 maps, "
+                      << "avx512 up to " << IFS_MAX_MAPS << ")" << std::endl;
+            return false;
+        }
+        pointVbo = VertexBuffer(ifsSystem.dimensions);
+        if (!fitViewToSystem()) {
+            std::cerr << "Error: " << ifsName << ": the attractor does not fit in float range"
+                      << std::endl;
+            return false;
+        }
+    }
+    if (requestedPoints >= 0) {
+        if (headlessMode || benchMode) {
+            headlessPoints = requestedPoints;
+        } else {
+            numPoints = static_cast<int>(requestedPoints < 2147483647LL ? requestedPoints : 2147483647LL);
+        }
     }
+    return true;
 }
 
 /*
  * Main function
  */
 int main(int argc, char** argv) {
+    if (!parseArguments(argc, argv)) {
+        return 1;
+    }
+    if (benchMode) {
+        return runBenchmark();
+    }
+    if (headlessMode) {
+        return runHeadless();
+    }
+    if (offscreen.enabled) {
+        return runOffscreen();
+    }
+
     glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
+    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB);
     glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
     glutInitWindowPosition(100, 100);
     glutCreateWindow("Sierpinski Gasket - 2D Random Point Method");
@@ -156,8 +1046,11 @@ int main(int argc, char** argv) {
     init();
     
     glutDisplayFunc(display);
+    glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     
+    resetProgress();
+    
     glutMainLoop();
     return 0;
 }
@@ -10,11 +10,66 @@
  * - +/-: Increase/decrease subdivision depth
  * - R: Reset view
  * - SPACE: Toggle fill/wireframe mode
+ * - V: Toggle vertex buffer / immediate mode drawing
+ * - C: Toggle collapsing sub-pixel triangles to points
+ * - X: Toggle the shared-vertex (indexed) mesh
+ * - F: Toggle the frame-time overlay
+ *
+ * The gasket is generated once per depth change into a vertex array,
+ * uploaded to a GPU vertex buffer and drawn with one glDrawArrays()
+ * per frame (see vertex_buffer.h). Pass --immediate, or press V, to
+ * draw each triangle with glBegin/glEnd instead.
+ *
+ * The vertex array is filled by the non-recursive engine in
+ * subdivision.h, which needs no GL context. --headless --depth N
+ * generates a mesh without opening a window and reports how long it
+ * took next to the recursive subdivideTriangle() and the engine with
+ * no unrolled kernels (--unroll N sets the levels the kernels in
+ * subdivision_kernels.h write, 0 to 6). Deep meshes are
+ * generated on all cores (--threads N to override); the output does
+ * not depend on the thread count.
+ *
+ * --indexed, or X, stores every shared corner once and draws the
+ * triangles from a 16/32-bit index buffer (see indexed_gasket.h).
+ *
+ * Depth is limited only by --memory-budget (MB of vertex data, default
+ * 256). Once the triangles get smaller than a pixel, subdividing them
+ * further changes nothing on screen, so leaves at that level are drawn
+ * as one point each instead; any depth then costs at most one point
+ * per pixel of the gasket. --no-cull, or C, turns this off.
+ *
+ * Frame times (mesh generation, GL submission, GPU time) are recorded
+ * by ../../common/frame_timer.h; --frame-csv PATH writes one row per
+ * frame.
+ *
+ * --offscreen renders --frames N frames without a window and writes
+ * the last one with --image (see ../../common/offscreen.h):
+ *   ./gasket_2d_subdivision --offscreen --depth 10 --frames 100 --image gasket.png
+ * --bench-json PATH appends the run's results to PATH as one JSON line
+ * (see ../../common/bench_report.h and bench.sh).
  */
 
-#include <GLUT/glut.h>
+#ifdef __APPLE__
+    #include <GLUT/glut.h>
+#else
+    #define GL_GLEXT_PROTOTYPES  // declare buffer object entry points
+    #include <GL/glut.h>
+#endif
 #include <iostream>
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "gasket_geometry.h"
+#include "indexed_gasket.h"
+#include "subdivision.h"
+#include "vertex_buffer.h"
+#include "../../common/bench_report.h"
+#include "../../common/frame_timer.h"
+#include "../../common/offscreen.h"
 
 // Window dimensions
 const int WINDOW_WIDTH = 800;
@@ -22,8 +77,25 @@ const int WINDOW_HEIGHT = 800;
 
 // Subdivision depth (number of recursive iterations)
 int subdivisionDepth = 5;
-const int MAX_DEPTH = 8;
+const int MAX_DEPTH = SUBDIVISION_MAX_LEVELS;
 const int MIN_DEPTH = 0;
+const int GRADIENT_DEPTH = 8;   // depth at which the color gradient ends
+
+// Current window size, for the sub-pixel test
+int windowWidth = WINDOW_WIDTH;
+int windowHeight = WINDOW_HEIGHT;
+
+// Vertex data allowed for the mesh, in MB (--memory-budget)
+double memoryBudgetMB = 256.0;
+
+// Collapse leaves smaller than a pixel to points (C, --no-cull)
+bool cullSubpixel = true;
+
+// Threads used to generate the mesh (--threads, 0 = all cores)
+int numThreads = 0;
+
+// Bottom levels written by an unrolled kernel (--unroll)
+int unrolledLevels = UNROLLED_DEFAULT_LEVELS;
 
 // Fill or wireframe mode
 bool fillMode = true;
@@ -38,6 +110,38 @@ point2 vertices[3] = {
     {0.0f, 0.9f}     // Top
 };
 
+// Generated gasket: 3 vertices (x, y) per leaf triangle, or one
+// (x, y) centroid per leaf when meshPoints is set
+std::vector<float> mesh;
+int meshDepth = -1;        // depth mesh was generated for, -1 = none
+int meshLeafDepth = -1;    // depth of the leaves actually stored
+bool meshPoints = false;
+
+// Shared-vertex version of the mesh (--indexed, X); points are never
+// shared, so sub-pixel meshes stay in mesh
+bool useIndexed = false;
+bool meshIndexed = false;   // indexedMesh holds the current mesh
+IndexedGasket indexedMesh;
+
+// GPU copy of mesh, drawn with a single glDrawArrays() (or of
+// indexedMesh, drawn with a single glDrawElements())
+VertexBuffer meshVbo(2);
+IndexBuffer meshIbo;
+bool useVertexBuffers = true;
+bool vertexBuffersAvailable = false;
+
+// Headless mesh generation (see runHeadless)
+bool headlessMode = false;
+
+// Frame-time statistics (F toggles the overlay)
+FrameTimer frameTimer;
+
+// Windowless rendering (--offscreen)
+OffscreenOptions offscreen;
+
+// Results of offscreen runs (--bench-json)
+BenchReport benchReport;
+
 /*
  * Initialize OpenGL settings
  */
@@ -47,16 +151,88 @@ void init() {
     glLoadIdentity();
     gluOrtho2D(-1.0, 1.0, -1.0, 1.0);
     
+    vertexBuffersAvailable = VertexBuffer::supported();
+    if (!vertexBuffersAvailable) {
+        useVertexBuffers = false;
+        std::cout << "Vertex buffers not supported, using immediate mode" << std::endl;
+    }
+    
     std::cout << "=== Sierpinski Gasket - 2D Subdivision Method ===" << std::endl;
     std::cout << "Current subdivision depth: " << subdivisionDepth << std::endl;
-    std::cout << "Controls: +/- to adjust depth (0-" << MAX_DEPTH << "), " 
-              << "SPACE to toggle fill, ESC to exit" << std::endl;
+    std::cout << "Controls: +/- to adjust depth, SPACE to toggle fill, "
+              << "V for vertex buffer/immediate, C for sub-pixel culling, X for indexed mesh, "
+              << "F for frame times, ESC to exit" << std::endl;
+}
+
+/*
+ * Depth at which leaves become smaller than a pixel, or depth itself
+ * when culling is off or the leaves are still visible
+ */
+int leafDepth(int depth) {
+    if (!cullSubpixel || headlessMode) {
+        return depth;
+    }
+    // Bounding box of the initial triangle in pixels; the projection
+    // maps [-1, 1] onto the window
+    float minX = vertices[0][0], maxX = minX, minY = vertices[0][1], maxY = minY;
+    for (int i = 1; i < 3; i++) {
+        minX = std::min(minX, vertices[i][0]);
+        maxX = std::max(maxX, vertices[i][0]);
+        minY = std::min(minY, vertices[i][1]);
+        maxY = std::max(maxY, vertices[i][1]);
+    }
+    double extent = std::max((maxX - minX) * windowWidth / 2.0, (maxY - minY) * windowHeight / 2.0);
+    return std::min(depth, subpixelDepth(extent));
 }
 
 /*
- * Draw a single triangle
+ * Bytes of vertex data needed for the mesh at a depth
  */
-void drawTriangle(point2 a, point2 b, point2 c) {
+double meshBytes(int depth) {
+    int leaves = leafDepth(depth);
+    if (useIndexed && leaves == depth) {
+        return static_cast<double>(gasketIndexedBytes(false, leaves));
+    }
+    return static_cast<double>(gasketMeshBytes(leaves < depth ? MESH_CENTROIDS_2D : MESH_TRIANGLES_2D,
+                                               leaves));
+}
+
+bool withinBudget(int depth) {
+    return meshBytes(depth) <= memoryBudgetMB * 1024.0 * 1024.0;
+}
+
+/*
+ * Bytes runHeadless() holds at once: the first mesh, kept for the
+ * comparisons, plus the odometer or recursive copy or the indexed mesh
+ */
+double headlessPeakBytes(int depth) {
+    double triangles = static_cast<double>(gasketMeshBytes(MESH_TRIANGLES_2D, depth));
+    double indexed = static_cast<double>(gasketIndexedBytes(false, depth));
+    return triangles + std::max(triangles, indexed);
+}
+
+/*
+ * Step the depth back until its mesh fits in the memory budget. The
+ * depth leaves are cut off at grows with the window, so a depth that
+ * fit when it was chosen may not after a resize.
+ */
+void fitDepthToBudget() {
+    if (withinBudget(subdivisionDepth)) {
+        return;
+    }
+    int requested = subdivisionDepth;
+    while (subdivisionDepth > MIN_DEPTH && !withinBudget(subdivisionDepth)) {
+        subdivisionDepth--;
+    }
+    std::cerr << "Depth " << requested << " needs " << meshBytes(requested) / (1024.0 * 1024.0)
+              << " MB, over the " << memoryBudgetMB << " MB budget; using depth "
+              << subdivisionDepth << std::endl;
+}
+
+/*
+ * Draw a single triangle (immediate mode fallback)
+ */
+void drawTriangle(const float* a, const float* b, const float* c) {
     glBegin(fillMode ? GL_TRIANGLES : GL_LINE_LOOP);
     glVertex2fv(a);
     glVertex2fv(b);
@@ -64,6 +240,13 @@ void drawTriangle(point2 a, point2 b, point2 c) {
     glEnd();
 }
 
+/*
+ * Append a leaf triangle to the mesh (recursive reference path)
+ */
+void addTriangle(point2 a, point2 b, point2 c) {
+    mesh.insert(mesh.end(), {a[0], a[1], b[0], b[1], c[0], c[1]});
+}
+
 /*
  * Recursive subdivision algorithm
  * 
@@ -76,15 +259,19 @@ void drawTriangle(point2 a, point2 b, point2 c) {
  *   depth: Current recursion depth
  * 
  * Algorithm:
- * 1. If depth reaches 0, draw the triangle
+ * 1. If depth reaches 0, add the triangle to the mesh
  * 2. Otherwise, calculate midpoints of all three sides
  * 3. Recursively subdivide the three corner triangles
  * 4. Skip the center triangle (this creates the gasket pattern)
+ *
+ * The program builds its mesh with generateGasket2D() from
+ * subdivision.h, which produces the same triangles without recursion;
+ * this version is kept as the reference it is checked against.
  */
 void subdivideTriangle(point2 a, point2 b, point2 c, int depth) {
     if (depth == 0) {
-        // Base case: draw the triangle
-        drawTriangle(a, b, c);
+        // Base case: keep the triangle
+        addTriangle(a, b, c);
     } else {
         // Calculate midpoints
         point2 ab, bc, ca;
@@ -110,22 +297,134 @@ void subdivideTriangle(point2 a, point2 b, point2 c, int depth) {
     }
 }
 
+/*
+ * Bytes of vertex (and index) data of the current mesh
+ */
+size_t meshByteCount() {
+    return meshIndexed ? indexedMesh.bytes() : mesh.size() * sizeof(float);
+}
+
+/*
+ * Regenerate the mesh for the current depth and upload it
+ */
+void buildMesh() {
+    // Checked before anything is allocated
+    fitDepthToBudget();
+    meshLeafDepth = leafDepth(subdivisionDepth);
+    meshPoints = meshLeafDepth < subdivisionDepth;
+    
+    meshIndexed = useIndexed && !meshPoints;
+    
+    // Sized exactly once from the size table, no growth while generating
+    uint64_t leaves = GASKET_2D_LEVELS[meshLeafDepth].leaves;
+    if (meshIndexed) {
+        std::vector<float>().swap(mesh);
+        generateIndexedGasket2D(vertices[0], vertices[1], vertices[2], meshLeafDepth,
+                                indexedMesh, numThreads);
+    } else {
+        indexedMesh.clear();
+        allocateMesh(mesh, gasketMeshFloats(meshPoints ? MESH_CENTROIDS_2D : MESH_TRIANGLES_2D,
+                                            meshLeafDepth));
+        if (meshPoints) {
+            generateGasketCentroids2D(vertices[0], vertices[1], vertices[2], meshLeafDepth,
+                                      mesh.data(), numThreads, unrolledLevels);
+        } else {
+            generateGasket2D(vertices[0], vertices[1], vertices[2], meshLeafDepth,
+                             mesh.data(), numThreads, unrolledLevels);
+        }
+    }
+    if (useVertexBuffers) {
+        if (!meshIndexed) {
+            meshVbo.assign(mesh);
+        } else if (indexedMesh.wide()) {
+            meshVbo.assign(indexedMesh.vertices);
+            meshIbo.assign(indexedMesh.indices32);
+        } else {
+            meshVbo.assign(indexedMesh.vertices);
+            meshIbo.assign(indexedMesh.indices16);
+        }
+    }
+    meshDepth = subdivisionDepth;
+    
+    std::cerr << "Depth " << subdivisionDepth << ": " << gasketTriangleCount(subdivisionDepth)
+              << " triangles";
+    if (meshPoints) {
+        std::cerr << ", drawn as " << leaves << " points (depth " << meshLeafDepth << ")";
+    }
+    if (meshIndexed) {
+        std::cerr << ", " << indexedMesh.vertices.size() / FLOATS_PER_POINT_2D << " shared vertices, "
+                  << (indexedMesh.wide() ? 32 : 16) << "-bit indices";
+    }
+    std::cerr << ", " << meshByteCount() / (1024.0 * 1024.0) << " MB" << std::endl;
+}
+
 /*
  * Display callback - renders the Sierpinski Gasket
  */
 void display() {
+    frameTimer.beginFrame();
+    
+    // Geometry only changes with the depth (or the pixel size)
+    if (meshDepth != subdivisionDepth || meshLeafDepth != leafDepth(subdivisionDepth)) {
+        frameTimer.beginGeneration();
+        buildMesh();
+        frameTimer.endGeneration();
+    }
+    
+    frameTimer.beginSubmission();
     glClear(GL_COLOR_BUFFER_BIT);
     
     // Use a gradient color based on depth for visual interest
-    float colorIntensity = 0.2f + (subdivisionDepth / (float)MAX_DEPTH) * 0.8f;
+    float colorIntensity = 0.2f + (std::min(subdivisionDepth, GRADIENT_DEPTH) / (float)GRADIENT_DEPTH) * 0.8f;
     glColor3f(colorIntensity, 0.5f, 1.0f - colorIntensity);
     
-    // Start the recursive subdivision
-    subdivideTriangle(vertices[0], vertices[1], vertices[2], subdivisionDepth);
+    if (meshPoints) {
+        // Sub-pixel leaves: one point each
+        if (useVertexBuffers) {
+            meshVbo.draw(GL_POINTS);
+        } else {
+            glBegin(GL_POINTS);
+            for (size_t i = 0; i < mesh.size(); i += FLOATS_PER_POINT_2D) {
+                glVertex2fv(&mesh[i]);
+            }
+            glEnd();
+        }
+    } else if (useVertexBuffers) {
+        // Wireframe via polygon mode draws the same edges as GL_LINE_LOOP
+        glPolygonMode(GL_FRONT_AND_BACK, fillMode ? GL_FILL : GL_LINE);
+        if (meshIndexed) {
+            meshVbo.drawIndexed(GL_TRIANGLES, meshIbo);
+        } else {
+            meshVbo.draw(GL_TRIANGLES);
+        }
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    } else if (meshIndexed) {
+        const float* v = indexedMesh.vertices.data();
+        for (size_t i = 0; i < indexedMesh.indexCount(); i += 3) {
+            drawTriangle(v + 2 * indexedMesh.index(i), v + 2 * indexedMesh.index(i + 1),
+                         v + 2 * indexedMesh.index(i + 2));
+        }
+    } else {
+        for (size_t i = 0; i < mesh.size(); i += 6) {
+            drawTriangle(&mesh[i], &mesh[i + 2], &mesh[i + 4]);
+        }
+    }
     
+    frameTimer.endSubmission();
+    frameTimer.endFrame();
     glFlush();
 }
 
+/*
+ * Window reshape callback - the pixel size decides where leaves are
+ * collapsed to points
+ */
+void reshape(int w, int h) {
+    glViewport(0, 0, w, h);
+    windowWidth = w;
+    windowHeight = h;
+}
+
 /*
  * Keyboard callback for interactive controls
  */
@@ -136,12 +435,16 @@ void keyboard(unsigned char key, int x, int y) {
             break;
         case '+':
         case '=':
-            if (subdivisionDepth < MAX_DEPTH) {
+            if (subdivisionDepth >= MAX_DEPTH) {
+                std::cout << "Maximum depth reached (" << MAX_DEPTH << ")" << std::endl;
+            } else if (!withinBudget(subdivisionDepth + 1)) {
+                std::cout << "Depth " << subdivisionDepth + 1 << " needs "
+                          << meshBytes(subdivisionDepth + 1) / (1024.0 * 1024.0)
+                          << " MB, over the " << memoryBudgetMB << " MB budget" << std::endl;
+            } else {
                 subdivisionDepth++;
                 std::cout << "Subdivision depth increased to: " << subdivisionDepth << std::endl;
                 glutPostRedisplay();
-            } else {
-                std::cout << "Maximum depth reached (" << MAX_DEPTH << ")" << std::endl;
             }
             break;
         case '-':
@@ -166,13 +469,228 @@ void keyboard(unsigned char key, int x, int y) {
             std::cout << "Reset to default settings" << std::endl;
             glutPostRedisplay();
             break;
+        case 'v':
+        case 'V':
+            if (!vertexBuffersAvailable) {
+                std::cout << "Vertex buffers not supported" << std::endl;
+                break;
+            }
+            useVertexBuffers = !useVertexBuffers;
+            meshDepth = -1;  // rebuild (and upload) on the next frame
+            std::cout << "Drawing: " << (useVertexBuffers ? "Vertex buffer" : "Immediate mode") << std::endl;
+            glutPostRedisplay();
+            break;
+        case 'c':
+        case 'C':
+            cullSubpixel = !cullSubpixel;
+            // Full geometry may not fit: step back to a depth that does
+            fitDepthToBudget();
+            std::cout << "Sub-pixel culling: " << (cullSubpixel ? "ON" : "OFF") << std::endl;
+            glutPostRedisplay();
+            break;
+        case 'x':
+        case 'X':
+            useIndexed = !useIndexed;
+            fitDepthToBudget();
+            meshDepth = -1;  // rebuild on the next frame
+            std::cout << "Mesh: " << (useIndexed ? "Indexed (shared vertices)" : "Separate triangles")
+                      << std::endl;
+            glutPostRedisplay();
+            break;
+        case 'f':
+        case 'F':
+            frameTimer.toggleOverlay();
+            glutPostRedisplay();
+            break;
+    }
+}
+
+/*
+ * Milliseconds elapsed since start
+ */
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * Headless mode: generate the mesh for subdivisionDepth without GL,
+ * then generate it again with the odometer alone (no unrolled levels),
+ * with the recursive subdivideTriangle() and as an indexed mesh, and
+ * check that all four produced the same triangles
+ */
+int runHeadless() {
+    useVertexBuffers = false;  // no GL context to upload to
+    useIndexed = false;        // the indexed mesh is checked last
+    auto start = std::chrono::steady_clock::now();
+    buildMesh();
+    double unrolledMs = elapsedMs(start);
+    std::cerr << "Unrolled " << unrolledLevels << " levels (" << numThreads << " threads): "
+              << unrolledMs << " ms" << std::endl;
+    
+    std::vector<float> iterative;
+    iterative.swap(mesh);
+    int levels = unrolledLevels;
+    unrolledLevels = 0;
+    start = std::chrono::steady_clock::now();
+    buildMesh();
+    double odometerMs = elapsedMs(start);
+    std::cerr << "Odometer only (" << numThreads << " threads): " << odometerMs << " ms" << std::endl;
+    unrolledLevels = levels;
+    bool same = iterative == mesh;
+    
+    std::vector<float>().swap(mesh);
+    start = std::chrono::steady_clock::now();
+    subdivideTriangle(vertices[0], vertices[1], vertices[2], subdivisionDepth);
+    double recursiveMs = elapsedMs(start);
+    std::cerr << "Recursive: " << recursiveMs << " ms" << std::endl;
+
+    same = same && iterative == mesh;
+    std::vector<float>().swap(mesh);
+
+    start = std::chrono::steady_clock::now();
+    generateIndexedGasket2D(vertices[0], vertices[1], vertices[2], subdivisionDepth,
+                            indexedMesh, numThreads);
+    double indexedMs = elapsedMs(start);
+    std::cerr << "Indexed (" << numThreads << " threads): " << indexedMs << " ms, "
+              << indexedMesh.bytes() / (1024.0 * 1024.0) << " MB instead of "
+              << iterative.size() * sizeof(float) / (1024.0 * 1024.0) << " MB" << std::endl;
+    same = same && indexedMesh.indexCount() * FLOATS_PER_POINT_2D == iterative.size();
+    for (size_t i = 0; same && i < indexedMesh.indexCount(); i++) {
+        const float* v = &indexedMesh.vertices[indexedMesh.index(i) * FLOATS_PER_POINT_2D];
+        same = v[0] == iterative[2 * i] && v[1] == iterative[2 * i + 1];
     }
+    std::cerr << "Meshes " << (same ? "match" : "DIFFER") << std::endl;
+
+    uint64_t leaves = gasketTriangleCount(subdivisionDepth);
+    benchReport.addString("program", "gasket_2d_subdivision");
+    benchReport.addString("mode", "headless");
+    benchReport.addInteger("depth", subdivisionDepth);
+    benchReport.addInteger("leaves", static_cast<long long>(leaves));
+    benchReport.addInteger("unrolled_levels", unrolledLevels);
+    benchReport.addInteger("threads", numThreads);
+    benchReport.addNumber("unrolled_ms", unrolledMs);
+    benchReport.addNumber("odometer_ms", odometerMs);
+    benchReport.addNumber("recursive_ms", recursiveMs);
+    benchReport.addNumber("indexed_ms", indexedMs);
+    benchReport.addInteger("mesh_bytes", static_cast<long long>(iterative.size() * sizeof(float)));
+    benchReport.addInteger("indexed_bytes", static_cast<long long>(indexedMesh.bytes()));
+    benchReport.addRate("leaves_per_second", static_cast<double>(leaves), unrolledMs);
+    benchReport.addBool("match", same);
+    benchReport.addPeakMemory();
+    if (!benchReport.write()) {
+        return 1;
+    }
+    return same ? 0 : 1;
+}
+
+/*
+ * Offscreen mode: draw the current depth --frames times into an
+ * offscreen framebuffer, with no window
+ */
+int runOffscreen() {
+    offscreen.defaultSize(WINDOW_WIDTH, WINDOW_HEIGHT);
+    int status = renderOffscreen(offscreen, frameTimer, false, []() {
+        init();
+        reshape(offscreen.width, offscreen.height);
+    }, display);
+    if (status != 0) {
+        return status;
+    }
+
+    // Leaves are the triangles (or points) actually generated and drawn
+    uint64_t leaves = gasketTriangleCount(meshLeafDepth);
+    benchReport.addString("program", "gasket_2d_subdivision");
+    benchReport.addString("mode", "offscreen");
+    benchReport.addInteger("depth", subdivisionDepth);
+    benchReport.addInteger("leaf_depth", meshLeafDepth);
+    benchReport.addInteger("leaves", static_cast<long long>(leaves));
+    benchReport.addBool("points", meshPoints);
+    benchReport.addBool("indexed", meshIndexed);
+    benchReport.addInteger("mesh_bytes", static_cast<long long>(meshByteCount()));
+    benchReport.addBool("vertex_buffers", useVertexBuffers);
+    benchReport.addInteger("threads", numThreads);
+    benchReport.addInteger("width", offscreen.width);
+    benchReport.addInteger("height", offscreen.height);
+    benchReport.addFrameTimes(frameTimer);
+    benchReport.addRate("leaves_per_second", static_cast<double>(leaves),
+                        frameTimer.stats(FrameTimer::GENERATION).total);
+    benchReport.addPeakMemory();
+    return benchReport.write() ? 0 : 1;
+}
+
+/*
+ * Parse command line options. Unrecognized arguments are left for
+ * glutInit().
+ */
+bool parseArguments(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (offscreen.parse(argc, argv, i) || benchReport.parse(argc, argv, i)) {
+            continue;
+        }
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--immediate") == 0) {
+            useVertexBuffers = false;
+        } else if (std::strcmp(argv[i], "--headless") == 0) {
+            headlessMode = true;
+        } else if (std::strcmp(argv[i], "--depth") == 0 && hasValue) {
+            subdivisionDepth = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--memory-budget") == 0 && hasValue) {
+            memoryBudgetMB = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--no-cull") == 0) {
+            cullSubpixel = false;
+        } else if (std::strcmp(argv[i], "--indexed") == 0) {
+            useIndexed = true;
+        } else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+            numThreads = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--unroll") == 0 && hasValue) {
+            unrolledLevels = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--frame-csv") == 0 && hasValue) {
+            const char* path = argv[++i];
+            if (!frameTimer.openCsv(path)) {
+                std::cerr << "Error: cannot write " << path << std::endl;
+                return false;
+            }
+        }
+    }
+    if (numThreads <= 0) {
+        numThreads = static_cast<int>(std::thread::hardware_concurrency());
+        if (numThreads < 1) numThreads = 1;
+    }
+    if (subdivisionDepth < MIN_DEPTH || subdivisionDepth > MAX_DEPTH) {
+        std::cerr << "Error: --depth must be between " << MIN_DEPTH << " and "
+                  << MAX_DEPTH << std::endl;
+        return false;
+    }
+    if (unrolledLevels < 0 || unrolledLevels > UNROLLED_MAX_DEPTH) {
+        std::cerr << "Error: --unroll must be between 0 and " << UNROLLED_MAX_DEPTH << std::endl;
+        return false;
+    }
+    // Headless runs keep two meshes at once to compare them
+    double needed = headlessMode ? headlessPeakBytes(subdivisionDepth) : meshBytes(subdivisionDepth);
+    if (needed > memoryBudgetMB * 1024.0 * 1024.0) {
+        std::cerr << "Error: depth " << subdivisionDepth << " needs " << needed / (1024.0 * 1024.0)
+                  << " MB" << (headlessMode ? " for two meshes" : "") << ", over the "
+                  << memoryBudgetMB << " MB budget (see --memory-budget)" << std::endl;
+        return false;
+    }
+    return true;
 }
 
 /*
  * Main function
  */
 int main(int argc, char** argv) {
+    if (!parseArguments(argc, argv)) {
+        return 1;
+    }
+    if (headlessMode) {
+        return runHeadless();
+    }
+    if (offscreen.enabled) {
+        return runOffscreen();
+    }
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
     glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
@@ -182,6 +700,7 @@ int main(int argc, char** argv) {
     init();
     
     glutDisplayFunc(display);
+    glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     
     glutMainLoop();
@@ -9,14 +9,71 @@
  * - ESC: Exit the program
  * - +/-: Increase/decrease subdivision depth
  * - Arrow Keys: Rotate the tetrahedron
- * - R: Reset rotation
+ * - R: Reset rotation, zoom and focus
  * - SPACE: Toggle rotation animation
  * - W: Toggle wireframe mode
+ * - V: Toggle vertex buffer / immediate mode drawing
+ * - C: Toggle collapsing sub-pixel tetrahedra to points
+ * - I: Toggle instanced drawing
+ * - X: Toggle the shared-vertex (indexed) mesh
+ * - L: Toggle view-dependent level of detail
+ * - G: Toggle the chaos-game point cloud
+ * - S: Toggle depth-sorted splats (point cloud)
+ * - Page Up/Down: Zoom in/out (up to 1e5, or 1e30 with L)
+ * - Shift + Arrow Keys: Move the zoom focus
+ * - F: Toggle the frame-time overlay
+ *
+ * The mesh is generated on all cores (tetrahedron_subdivision.h) into
+ * four face sections, one per color and normal, and cached in a
+ * vertex buffer until the depth or drawing method changes (MeshKey).
+ * Tetrahedra smaller than a pixel are drawn as points (--no-cull
+ * turns this off), and --memory-budget MB caps the depth.
+ *
+ * The other modes live in their own headers: --instanced
+ * (instanced_mesh.h), --indexed (indexed_gasket.h), --lod PIXELS with
+ * --zoom and --focus (level_of_detail.h), --chaos N and --splats
+ * PIXELS (point_cloud.h), and --export PATH (gasket_export.h).
+ * --offscreen, --frame-csv and --bench-json are the shared tools in
+ * ../../common. README.md lists every option with examples, e.g.:
+ *   ./gasket_3d_tetrahedron --offscreen --depth 8 --frames 100 --image gasket.png
+ *   ./gasket_3d_tetrahedron --export gasket.stl --depth 12
+ *
+ * The animation advances by the measured frame time, so it turns at
+ * the same speed whatever the frame rate; the idle callback only runs
+ * while it is on.
  */
 
-#include <GLUT/glut.h>
+#ifdef __APPLE__
+    #include <GLUT/glut.h>
+#else
+    #define GL_GLEXT_PROTOTYPES  // declare buffer object entry points
+    #include <GL/glut.h>
+#endif
 #include <iostream>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "gasket_geometry.h"
+#include "ifs_engine.h"
+#include "indexed_gasket.h"
+#include "instanced_mesh.h"
+#include "gasket_export.h"
+#include "level_of_detail.h"
+#include "point_cloud.h"
+#include "subdivision.h"
+#include "tetrahedron_subdivision.h"
+#include "vertex_buffer.h"
+#include "../../common/bench_report.h"
+#include "../../common/frame_timer.h"
+#include "../../common/offscreen.h"
 
 // Window dimensions
 const int WINDOW_WIDTH = 800;
@@ -24,8 +81,54 @@ const int WINDOW_HEIGHT = 800;
 
 // Subdivision depth
 int subdivisionDepth = 4;
-const int MAX_DEPTH = 6;
+const int MAX_DEPTH = TETRAHEDRON_MAX_LEVELS;
 const int MIN_DEPTH = 0;
+// Level-of-detail meshes are built per view, not from the size tables,
+// so they may go deeper: 2^-100 is about the size of a pixel at MAX_ZOOM
+const int LOD_MAX_DEPTH = 100;
+
+// Camera: eye distance, vertical field of view, clipping planes and
+// model scale
+const float EYE_DISTANCE = 3.0f;
+const float FIELD_OF_VIEW = 60.0f;
+const double NEAR_PLANE = 0.1;
+const double FAR_PLANE = 100.0;
+const float MODEL_SCALE = 0.8f;
+
+// Magnification (Page Up/Down, --zoom) about the zoom focus
+double zoom = 1.0;
+const double ZOOM_STEP = 1.25;
+const double MIN_ZOOM = 1.0;
+const double MAX_ZOOM = 1e30;
+// Meshes and the point cloud are drawn from float model coordinates,
+// which break up beyond this zoom; only level-of-detail meshes go on
+const double MAX_FLOAT_ZOOM = 1e5;
+
+// Point the view zooms in on (Shift + arrow keys, --focus)
+ZoomFocus focus;
+const double PAN_STEP = 0.1;    // fraction of the view height per key press
+
+// Current viewport size, for the sub-pixel and level-of-detail tests
+int windowWidth = WINDOW_WIDTH;
+int windowHeight = WINDOW_HEIGHT;
+
+// Depth from which tetrahedra are smaller than a pixel at that height
+// (updated by updateVisibleDepth() when the window changes)
+int visibleDepth = 0;
+
+// Vertex data allowed for the mesh, in MB (--memory-budget)
+double memoryBudgetMB = 256.0;
+
+// Collapse tetrahedra smaller than a pixel to points (C, --no-cull)
+bool cullSubpixel = true;
+
+// Threads used to generate the mesh (--threads, 0 = all cores)
+int numThreads = 0;
+
+// View-dependent level of detail (L, --lod PIXELS): stop subdividing
+// once a tetrahedron is at most lodPixels across on screen
+bool lodMode = false;
+double lodPixels = 4.0;
 
 // Rotation angles
 float rotationX = 30.0f;
@@ -34,14 +137,25 @@ float rotationZ = 0.0f;
 
 // Animation control
 bool animating = false;
-float animationSpeed = 0.5f;
+float animationSpeed = 30.0f;              // degrees per second
+const double MAX_ANIMATION_STEP = 0.1;     // seconds; skips stalls instead of jumping
+
+// Frame-time statistics (F toggles the overlay)
+FrameTimer frameTimer;
+
+// Windowless rendering (--offscreen)
+OffscreenOptions offscreen;
+
+// Results of offscreen runs (--bench-json)
+BenchReport benchReport;
+
+// Streamed mesh output (--export PATH, .stl or .ply)
+const char* exportPath = NULL;
+MeshExportFormat exportFormat = EXPORT_STL;
 
 // Wireframe mode
 bool wireframeMode = false;
 
-// 3D point structure
-typedef float point3[3];
-
 // Tetrahedron vertices (regular tetrahedron centered at origin)
 point3 vertices[4] = {
     {0.0f, 1.0f, 0.0f},           // Top vertex
@@ -50,6 +164,111 @@ point3 vertices[4] = {
     {0.866f, -0.5f, -0.433f}      // Back-right vertex
 };
 
+// The colors of the four faces (FACES in tetrahedron_subdivision.h).
+// Faces of one color all point the same way, so their normal is
+// computed once, by initFaceNormals().
+const float FACE_COLORS[NUM_FACES][3] = {
+    {1.0f, 0.0f, 0.0f},   // Red
+    {0.0f, 1.0f, 0.0f},   // Green
+    {0.0f, 0.0f, 1.0f},   // Blue
+    {1.0f, 1.0f, 0.0f}    // Yellow
+};
+float faceNormals[NUM_FACES][3];
+
+// Generated gasket: x, y, z per vertex, sorted by face into NUM_FACES
+// equal sections. Three vertices per face, or one point per face when
+// meshPoints is set.
+std::vector<float> mesh;
+static_assert(MESH_FLOATS_PER_LEAF[MESH_TRIANGLES_3D] == NUM_FACES * 3 * FLOATS_PER_VERTEX &&
+              MESH_FLOATS_PER_LEAF[MESH_FACE_POINTS_3D] == NUM_FACES * FLOATS_PER_VERTEX &&
+              MESH_FLOATS_PER_LEAF[MESH_INSTANCES_3D] == FLOATS_PER_INSTANCE,
+              "mesh layout differs from gasket_geometry.h");
+bool meshPoints = false;
+bool reportStateChanges = false;  // print the count after the next frame
+uint64_t meshLeaves = 0;          // tetrahedra in the cached mesh
+
+// What the cached mesh was generated for. Anything not in here (the
+// rotation, wireframe mode) does not require regenerating it, except
+// in level-of-detail mode, where the mesh depends on the whole view.
+struct MeshKey {
+    int depth;          // subdivisionDepth
+    int leafDepth;      // depth of the tetrahedra actually stored
+    bool instanced;     // instances + base shape rather than vertices
+    bool indexed;       // shared vertices + index buffer
+    bool lod;           // leaves chosen per tetrahedron from the view below
+    float rotation[3];
+    double zoom;
+    double focus[2][3];     // focus.hi, focus.lo
+    int width, height;
+
+    bool sameView(const MeshKey& other) const {
+        for (int i = 0; i < 3; i++) {
+            if (focus[0][i] != other.focus[0][i] || focus[1][i] != other.focus[1][i]) {
+                return false;
+            }
+        }
+        return rotation[0] == other.rotation[0] && rotation[1] == other.rotation[1] &&
+               rotation[2] == other.rotation[2] && zoom == other.zoom &&
+               width == other.width && height == other.height;
+    }
+
+    bool operator==(const MeshKey& other) const {
+        return depth == other.depth && leafDepth == other.leafDepth &&
+               instanced == other.instanced && indexed == other.indexed &&
+               lod == other.lod && (!lod || sameView(other));
+    }
+};
+// depth -1: nothing generated yet
+MeshKey meshKey = {-1, -1, false, false, false, {0.0f, 0.0f, 0.0f}, 1.0, {}, 0, 0};
+bool meshUploaded = false;             // meshVbo holds the cached mesh
+
+// Shared-vertex version of the mesh (--indexed, X): points once,
+// indices sorted into face sections like mesh. Only full triangles
+// share corners, so sub-pixel and instanced meshes never use it.
+bool useIndexed = false;
+IndexedGasket indexedMesh;
+
+// GPU copy of mesh, drawn with one glDrawArrays() per face section
+// (or of indexedMesh, one glDrawElements() per face section)
+VertexBuffer meshVbo(FLOATS_PER_VERTEX);
+IndexBuffer meshIbo;
+bool useVertexBuffers = true;
+bool vertexBuffersAvailable = false;
+
+// Instanced drawing: one offset + scale per tetrahedron, faces stored
+// once with their colors (x, y, z, r, g, b per vertex)
+const int FLOATS_PER_BASE_VERTEX = 6;
+InstancedMesh instancedMesh(FLOATS_PER_BASE_VERTEX);
+std::vector<float> instances;
+bool useInstancing = false;
+bool instancingAvailable = false;
+
+// Chaos-game point cloud (--chaos N, G): x, y, z per point, sorted
+// into NUM_FACES sections by the corner tetrahedron each point lies in
+// (cloudSections[k] to cloudSections[k + 1]) and drawn in that
+// corner's color
+bool chaosMode = false;
+long long chaosPoints = 1000000;
+const long long MAX_CHAOS_POINTS = UINT32_MAX;  // splat order is 32-bit
+uint64_t chaosSeed = 1;
+const long long CHAOS_BURN_IN = 64;             // steps discarded by each chain
+std::vector<float> cloud;
+size_t cloudSections[NUM_FACES + 1];
+long long cloudPoints = -1;                     // -1: nothing generated yet
+VertexBuffer cloudVbo(FLOATS_PER_VERTEX);
+bool cloudUploaded = false;
+
+// Depth-sorted splats (--splats PIXELS, S): the cloud back to front as
+// round, partly transparent points, x, y, z and r, g, b, a each
+bool splatMode = false;
+float splatSize = 3.0f;
+const float SPLAT_ALPHA = 0.4f;
+std::vector<float> splats;
+float splatRotation[3];
+bool splatsSorted = false;                      // splats match cloud and splatRotation
+VertexBuffer splatVbo(FLOATS_PER_VERTEX, 4);
+bool splatsUploaded = false;
+
 /*
  * Initialize OpenGL settings
  */
@@ -62,7 +281,7 @@ void init() {
     // Set up projection
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
-    gluPerspective(60.0, 1.0, 0.1, 100.0);
+    gluPerspective(FIELD_OF_VIEW, 1.0, NEAR_PLANE, FAR_PLANE);
     
     // Set up modelview
     glMatrixMode(GL_MODELVIEW);
@@ -70,21 +289,167 @@ void init() {
     // Enable smooth shading
     glShadeModel(GL_SMOOTH);
     
+    vertexBuffersAvailable = VertexBuffer::supported();
+    if (!vertexBuffersAvailable) {
+        useVertexBuffers = false;
+        std::cout << "Vertex buffers not supported, using immediate mode" << std::endl;
+    }
+    instancingAvailable = InstancedMesh::supported();
+    if (useInstancing && !instancingAvailable) {
+        useInstancing = false;
+        std::cout << "Instanced drawing needs OpenGL 3.3, not using it" << std::endl;
+    }
+    
     std::cout << "=== Sierpinski Gasket - 3D Tetrahedron Method ===" << std::endl;
     std::cout << "Current subdivision depth: " << subdivisionDepth << std::endl;
     std::cout << "Controls:" << std::endl;
-    std::cout << "  +/- : Adjust depth (0-" << MAX_DEPTH << ")" << std::endl;
+    std::cout << "  +/- : Adjust depth" << std::endl;
     std::cout << "  Arrow keys: Rotate" << std::endl;
     std::cout << "  SPACE: Toggle animation" << std::endl;
     std::cout << "  W: Toggle wireframe" << std::endl;
-    std::cout << "  R: Reset rotation" << std::endl;
+    std::cout << "  V: Toggle vertex buffer / immediate mode" << std::endl;
+    std::cout << "  C: Toggle sub-pixel culling" << std::endl;
+    std::cout << "  I: Toggle instanced drawing" << std::endl;
+    std::cout << "  X: Toggle indexed mesh" << std::endl;
+    std::cout << "  L: Toggle level of detail" << std::endl;
+    std::cout << "  G: Toggle chaos-game point cloud" << std::endl;
+    std::cout << "  S: Toggle depth-sorted splats" << std::endl;
+    std::cout << "  Page Up/Down: Zoom in/out (up to 1e5, or 1e30 with L)" << std::endl;
+    std::cout << "  Shift + arrow keys: Move the zoom focus" << std::endl;
+    std::cout << "  F: Toggle frame-time overlay" << std::endl;
+    std::cout << "  R: Reset rotation, zoom and focus" << std::endl;
     std::cout << "  ESC: Exit" << std::endl;
 }
 
+/*
+ * Default zoom focus: the midpoint of the top and front vertices,
+ * where two corner tetrahedra touch at every depth, so there is
+ * always gasket to see however far in
+ */
+void resetFocus() {
+    double midpoint[3];
+    for (int i = 0; i < 3; i++) {
+        midpoint[i] = (vertices[0][i] + vertices[1][i]) / 2.0;
+    }
+    focus.set(midpoint);
+}
+
+/*
+ * Recompute visibleDepth for the current window height and zoom
+ *
+ * The bound holds for every rotation: the gasket fits in a sphere of
+ * radius MODEL_SCALE * zoom (all vertices are at distance 1 from the
+ * origin) whose centre is MODEL_SCALE * zoom * |focus.viewCenter()| from the
+ * point looked at, so no part of it comes closer to the eye than
+ * `nearest` below. Each level halves the size. Once the sphere reaches
+ * the near plane there is no such bound and nothing is collapsed.
+ */
+void updateVisibleDepth() {
+    double center[3];
+    focus.viewCenter(zoom, center);
+    double offset = std::sqrt(center[0] * center[0] + center[1] * center[1] + center[2] * center[2]);
+    double scale = MODEL_SCALE * zoom;
+    double nearest = EYE_DISTANCE - scale * (offset + 1.0);
+    if (nearest <= NEAR_PLANE) {
+        visibleDepth = MAX_DEPTH;
+        return;
+    }
+    double viewHeight = 2.0 * nearest * std::tan(FIELD_OF_VIEW / 2.0 * M_PI / 180.0);
+    visibleDepth = subpixelDepth(2.0 * scale / viewHeight * windowHeight);
+}
+
+/*
+ * Deepest --depth the current mode allows
+ */
+int maxDepth() {
+    return lodMode ? LOD_MAX_DEPTH : MAX_DEPTH;
+}
+
+/*
+ * Deepest zoom the current mode can draw without float jitter
+ */
+double maxZoom() {
+    return lodMode && !chaosMode ? MAX_ZOOM : MAX_FLOAT_ZOOM;
+}
+
+/*
+ * Step the zoom back to maxZoom() after leaving level-of-detail mode
+ */
+void fitZoomToMode() {
+    if (zoom > maxZoom()) {
+        zoom = maxZoom();
+        updateVisibleDepth();
+        std::cout << "Zoom: " << zoom << " (the limit without level of detail)" << std::endl;
+    }
+}
+
+/*
+ * Depth at which tetrahedra become smaller than a pixel, or depth
+ * itself when culling is off or they are still visible
+ */
+int leafDepth(int depth) {
+    return cullSubpixel ? std::min(depth, visibleDepth) : depth;
+}
+
+/*
+ * Key of the mesh the current settings call for
+ */
+MeshKey currentMeshKey() {
+    if (lodMode) {
+        // Full triangles only, so depth is just the cap
+        MeshKey key = {subdivisionDepth, subdivisionDepth, false, false, true,
+                       {rotationX, rotationY, rotationZ}, zoom,
+                       {{focus.hi[0], focus.hi[1], focus.hi[2]}, {focus.lo[0], focus.lo[1], focus.lo[2]}},
+                       windowWidth, windowHeight};
+        return key;
+    }
+    int leaves = leafDepth(subdivisionDepth);
+    MeshKey key = {subdivisionDepth, leaves, useInstancing,
+                   useIndexed && !useInstancing && leaves == subdivisionDepth, false,
+                   {0.0f, 0.0f, 0.0f}, 1.0, {}, 0, 0};
+    return key;
+}
+
+/*
+ * Bytes of vertex data needed for the mesh at a depth
+ */
+double meshBytes(int depth) {
+    int leaves = leafDepth(depth);
+    if (useIndexed && !useInstancing && leaves == depth) {
+        return static_cast<double>(gasketIndexedBytes(true, leaves));
+    }
+    GasketMeshFormat format = useInstancing ? MESH_INSTANCES_3D
+                              : leaves < depth ? MESH_FACE_POINTS_3D : MESH_TRIANGLES_3D;
+    return static_cast<double>(gasketMeshBytes(format, leaves));
+}
+
+bool withinBudget(int depth) {
+    // Level-of-detail meshes stop growing at the budget (lodLeafLimit())
+    return lodMode || meshBytes(depth) <= memoryBudgetMB * 1024.0 * 1024.0;
+}
+
+/*
+ * Step the depth back until its mesh fits in the memory budget. The
+ * depth leaves are cut off at grows with the window, so a depth that
+ * fit when it was chosen may not after a resize.
+ */
+void fitDepthToBudget() {
+    if (withinBudget(subdivisionDepth)) {
+        return;
+    }
+    int requested = subdivisionDepth;
+    while (subdivisionDepth > MIN_DEPTH && !withinBudget(subdivisionDepth)) {
+        subdivisionDepth--;
+    }
+    std::cout << "Depth " << requested << " needs " << meshBytes(requested) / (1024.0 * 1024.0)
+              << " MB, over the " << memoryBudgetMB << " MB budget; using depth "
+              << subdivisionDepth << std::endl;
+}
+
 /*
  * Calculate normal vector for a triangle (for lighting)
  */
-void calculateNormal(point3 a, point3 b, point3 c, float normal[3]) {
+void calculateNormal(const point3 a, const point3 b, const point3 c, float normal[3]) {
     float v1[3], v2[3];
     
     // Calculate two edge vectors
@@ -111,64 +476,363 @@ void calculateNormal(point3 a, point3 b, point3 c, float normal[3]) {
 }
 
 /*
- * Draw a single triangle with color
+ * Normal of each face orientation, shared by all leaves
  */
-void drawTriangle(point3 a, point3 b, point3 c, float r, float g, float blue) {
-    if (wireframeMode) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    } else {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+void initFaceNormals() {
+    for (int f = 0; f < NUM_FACES; f++) {
+        calculateNormal(vertices[FACES[f][0]], vertices[FACES[f][1]], vertices[FACES[f][2]],
+                        faceNormals[f]);
     }
+}
+
+/*
+ * Generate the tetrahedra of depth `depth` into mesh on numThreads
+ * threads. The result is the same as one recursive call on the whole
+ * tetrahedron.
+ */
+void generateTetrahedra(int depth) {
+    allocateMesh(mesh, gasketMeshFloats(meshPoints ? MESH_FACE_POINTS_3D : MESH_TRIANGLES_3D, depth));
     
-    // Calculate and set normal for lighting
-    float normal[3];
-    calculateNormal(a, b, c, normal);
-    glNormal3fv(normal);
-    
-    glColor3f(r, g, blue);
-    glBegin(GL_TRIANGLES);
-    glVertex3fv(a);
-    glVertex3fv(b);
-    glVertex3fv(c);
-    glEnd();
+    forEachSubtree3D(depth, numThreads, [depth](uint64_t task, int split) {
+        point3 t[4];
+        std::copy(&vertices[0][0], &vertices[0][0] + 12, &t[0][0]);
+        descendTetrahedron(t, task, split);
+        // This subtree's slice of each face section
+        float* out[NUM_FACES];
+        for (int f = 0; f < NUM_FACES; f++) {
+            out[f] = mesh.data() + f * faceSectionFloats(depth, meshPoints)
+                     + task * faceSectionFloats(depth - split, meshPoints);
+        }
+        subdivideTetrahedron(t[0], t[1], t[2], t[3], depth - split, meshPoints, out);
+    });
 }
 
 /*
- * Recursive tetrahedron subdivision
- * 
- * Algorithm:
- * 1. If depth is 0, draw the four faces of the tetrahedron
- * 2. Otherwise, calculate midpoints of all six edges
- * 3. Recursively subdivide four corner tetrahedra
- * 
- * This creates a 3D fractal structure where each tetrahedron
- * is replaced by four smaller tetrahedra at its corners.
+ * Instance version of subdivideTetrahedron: a tetrahedron is the
+ * original one scaled by `scale` and moved by `offset`. Its corner
+ * tetrahedron c keeps vertex c and has half the size:
+ *
+ *   offset' = offset + scale / 2 * vertices[c],   scale' = scale / 2
+ *
+ * Writes FLOATS_PER_INSTANCE floats per tetrahedron at out and
+ * advances out.
  */
-void subdivideTetrahedron(point3 a, point3 b, point3 c, point3 d, int depth) {
+void subdivideInstances(const float offset[3], float scale, int depth, float*& out) {
     if (depth == 0) {
-        // Base case: draw the four triangular faces with different colors
-        drawTriangle(a, b, c, 1.0f, 0.0f, 0.0f);  // Red
-        drawTriangle(a, c, d, 0.0f, 1.0f, 0.0f);  // Green
-        drawTriangle(a, d, b, 0.0f, 0.0f, 1.0f);  // Blue
-        drawTriangle(b, d, c, 1.0f, 1.0f, 0.0f);  // Yellow
-    } else {
-        // Calculate midpoints of all six edges
-        point3 ab, ac, ad, bc, bd, cd;
-        
+        out[0] = offset[0];
+        out[1] = offset[1];
+        out[2] = offset[2];
+        out[3] = scale;
+        out += FLOATS_PER_INSTANCE;
+        return;
+    }
+    float half = scale / 2.0f;
+    for (int corner = 0; corner < 4; corner++) {
+        float child[3];
         for (int i = 0; i < 3; i++) {
-            ab[i] = (a[i] + b[i]) / 2.0f;
-            ac[i] = (a[i] + c[i]) / 2.0f;
-            ad[i] = (a[i] + d[i]) / 2.0f;
-            bc[i] = (b[i] + c[i]) / 2.0f;
-            bd[i] = (b[i] + d[i]) / 2.0f;
-            cd[i] = (c[i] + d[i]) / 2.0f;
+            child[i] = offset[i] + half * vertices[corner][i];
+        }
+        subdivideInstances(child, half, depth - 1, out);
+    }
+}
+
+/*
+ * Generate the offset and scale of every tetrahedron of depth `depth`
+ * into instances, in the same order as generateTetrahedra()
+ */
+void generateInstances(int depth) {
+    allocateMesh(instances, gasketMeshFloats(MESH_INSTANCES_3D, depth));
+    
+    forEachSubtree3D(depth, numThreads, [depth](uint64_t task, int split) {
+        float offset[3] = {0.0f, 0.0f, 0.0f};
+        float scale = 1.0f;
+        for (int level = 0; level < split; level++) {
+            int corner = subtreeCorner(task, split, level);
+            scale /= 2.0f;
+            for (int i = 0; i < 3; i++) {
+                offset[i] += scale * vertices[corner][i];
+            }
+        }
+        float* out = instances.data() + task * tetrahedronCount(depth - split) * FLOATS_PER_INSTANCE;
+        subdivideInstances(offset, scale, depth - split, out);
+    });
+}
+
+// Leaves of the last level-of-detail mesh, reused between rebuilds
+LodLeaves lod;
+
+/*
+ * The camera of display() as a LodView
+ */
+LodView currentLodView() {
+    LodView view;
+    viewRotation(rotationX, rotationY, rotationZ, view.rotation);
+    view.scale = MODEL_SCALE * zoom;
+    focus.viewCenterFromFocus(zoom, view.center);
+    view.tanY = std::tan(FIELD_OF_VIEW / 2.0 * M_PI / 180.0);
+    view.tanX = view.tanY * windowWidth / windowHeight;
+    view.height = windowHeight;
+    view.eyeDistance = EYE_DISTANCE;
+    view.nearPlane = NEAR_PLANE;
+    view.farPlane = FAR_PLANE;
+    return view;
+}
+
+/*
+ * Most leaves a level-of-detail mesh may have within --memory-budget
+ */
+uint64_t lodLeafLimit() {
+    double bytesPerLeaf = MESH_FLOATS_PER_LEAF[MESH_TRIANGLES_3D] * sizeof(float);
+    return std::max(1.0, memoryBudgetMB * 1024.0 * 1024.0 / bytesPerLeaf);
+}
+
+/*
+ * Bytes the point cloud needs for count points: positions, plus the
+ * splats and their sort keys in splat mode
+ */
+double cloudBytes(long long count) {
+    double perPoint = FLOATS_PER_VERTEX * sizeof(float);
+    if (splatMode) {
+        perPoint += FLOATS_PER_SPLAT * sizeof(float) + sizeof(std::pair<float, uint32_t>);
+    }
+    return perPoint * count;
+}
+
+bool cloudWithinBudget(long long count) {
+    return cloudBytes(count) <= memoryBudgetMB * 1024.0 * 1024.0;
+}
+
+/*
+ * Generate chaosPoints points of the attractor into cloud on
+ * numThreads threads, sorted into cloudSections
+ */
+void generateCloud() {
+    generateGasketCloud(vertices, chaosPoints, chaosSeed, numThreads, CHAOS_BURN_IN, cloud,
+                        cloudSections);
+    cloudPoints = chaosPoints;
+    cloudUploaded = false;
+    splatsSorted = false;
+    
+    std::cout << "Chaos game: " << cloudPoints << " points (seed " << chaosSeed << ", "
+              << numThreads << " threads), " << cloudBytes(cloudPoints) / (1024.0 * 1024.0)
+              << " MB" << std::endl;
+}
+
+/*
+ * Fill splats with the cloud sorted back to front for the current
+ * rotation. Only the rotation changes the order; the zoom scales and
+ * moves all points alike.
+ */
+void sortSplats() {
+    LodView view = currentLodView();
+    depthSortSplats(cloud, cloudSections, view.rotation[2], FACE_COLORS, SPLAT_ALPHA, splats);
+    splatRotation[0] = rotationX;
+    splatRotation[1] = rotationY;
+    splatRotation[2] = rotationZ;
+    splatsSorted = true;
+    splatsUploaded = false;
+}
+
+bool splatsCurrent() {
+    return splatsSorted && splatRotation[0] == rotationX && splatRotation[1] == rotationY &&
+           splatRotation[2] == rotationZ;
+}
+
+/*
+ * Regenerate the mesh for the current settings. Instanced meshes are
+ * uploaded here; the vertex buffer is filled by display() when needed.
+ */
+void buildMesh() {
+    // Checked before anything is allocated
+    fitDepthToBudget();
+    MeshKey previous = meshKey;
+    meshKey = currentMeshKey();
+    int storedDepth = meshKey.leafDepth;
+    meshPoints = storedDepth < subdivisionDepth;
+    
+    size_t bytes;
+    if (meshKey.lod) {
+        std::vector<float>().swap(instances);
+        indexedMesh.clear();
+        LodView view = currentLodView();
+        double offset[3] = {-focus.hi[0], -focus.hi[1], -focus.hi[2]};
+        collectLodLeaves(view, vertices, offset, subdivisionDepth, lodPixels, lodLeafLimit(), lod);
+        generateLodMesh(view, vertices, lod.leaves, mesh);
+        meshLeaves = lod.leaves.size();
+        meshUploaded = false;
+        // Only the view changed: rebuilt every frame while moving, so
+        // only changes of mode or depth are reported
+        if (previous.lod && previous.depth == meshKey.depth) {
+            return;
+        }
+        reportStateChanges = true;
+        std::cout << "Level of detail (" << lodPixels << " px, depth up to " << subdivisionDepth
+                  << "): " << meshLeaves << " tetrahedra, " << 4 * meshLeaves
+                  << " triangles, deepest " << lod.deepest;
+        if (lod.capped) {
+            std::cout << ", stopped at the " << memoryBudgetMB << " MB budget";
+        }
+        std::cout << std::endl;
+        return;
+    } else if (useInstancing) {
+        // Base shape: the depth-0 mesh, with each face's color added
+        generateTetrahedra(0);
+        std::vector<float> base;
+        size_t faceVertices = mesh.size() / FLOATS_PER_VERTEX / NUM_FACES;
+        for (size_t v = 0; v < mesh.size() / FLOATS_PER_VERTEX; v++) {
+            const float* color = FACE_COLORS[v / faceVertices];
+            base.insert(base.end(), mesh.begin() + v * FLOATS_PER_VERTEX,
+                        mesh.begin() + (v + 1) * FLOATS_PER_VERTEX);
+            base.insert(base.end(), color, color + 3);
+        }
+        indexedMesh.clear();
+        generateInstances(storedDepth);
+        instancedMesh.setBase(base);
+        instancedMesh.setInstances(instances);
+        bytes = (base.size() + instances.size()) * sizeof(float);
+    } else if (meshKey.indexed) {
+        std::vector<float>().swap(instances);
+        std::vector<float>().swap(mesh);
+        generateIndexedGasket3D(vertices, FACES, storedDepth, indexedMesh, numThreads);
+        bytes = indexedMesh.bytes();
+    } else {
+        std::vector<float>().swap(instances);
+        indexedMesh.clear();
+        generateTetrahedra(storedDepth);
+        bytes = mesh.size() * sizeof(float);
+    }
+    meshLeaves = tetrahedronCount(storedDepth);
+    meshUploaded = false;
+    reportStateChanges = true;
+    
+    std::cout << "Depth " << subdivisionDepth << ": " << tetrahedronCount(subdivisionDepth)
+              << " tetrahedra, " << 4 * tetrahedronCount(subdivisionDepth) << " triangles";
+    if (meshPoints) {
+        std::cout << ", drawn as " << 4 * tetrahedronCount(storedDepth) << " points (depth "
+                  << storedDepth << ")";
+    }
+    if (useInstancing) {
+        std::cout << ", " << tetrahedronCount(storedDepth) << " instances";
+    }
+    if (meshKey.indexed) {
+        std::cout << ", " << indexedMesh.vertices.size() / FLOATS_PER_POINT_3D << " shared vertices, "
+                  << (indexedMesh.wide() ? 32 : 16) << "-bit indices";
+    }
+    std::cout << ", " << bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+}
+
+/*
+ * Draw the cached mesh, uploading it first if it changed
+ */
+void drawMesh() {
+    if (useVertexBuffers && !meshKey.instanced && !meshUploaded) {
+        if (!meshKey.indexed) {
+            meshVbo.assign(mesh);
+        } else if (indexedMesh.wide()) {
+            meshVbo.assign(indexedMesh.vertices);
+            meshIbo.assign(indexedMesh.indices32);
+        } else {
+            meshVbo.assign(indexedMesh.vertices);
+            meshIbo.assign(indexedMesh.indices16);
+        }
+        meshUploaded = true;
+    }
+    
+    // Draw the 3D Sierpinski gasket: state is set per batch, not per
+    // triangle (stateChanges counts the glPolygonMode/glColor/glNormal
+    // calls)
+    int stateChanges = 1;
+    GLenum mode = meshPoints ? GL_POINTS : GL_TRIANGLES;
+    glPolygonMode(GL_FRONT_AND_BACK, wireframeMode ? GL_LINE : GL_FILL);
+    if (meshKey.instanced) {
+        instancedMesh.draw(mode);
+    } else {
+        // Vertices (or indices) per face section
+        bool indexed = meshKey.indexed;
+        size_t stored = indexed ? indexedMesh.indexCount() : mesh.size() / FLOATS_PER_VERTEX;
+        GLsizei faceVertices = static_cast<GLsizei>(stored / NUM_FACES);
+        for (int f = 0; f < NUM_FACES; f++) {
+            glColor3fv(FACE_COLORS[f]);
+            glNormal3fv(faceNormals[f]);
+            stateChanges += 2;
+            if (useVertexBuffers && indexed) {
+                meshVbo.drawIndexed(mode, meshIbo, f * faceVertices, faceVertices);
+            } else if (useVertexBuffers) {
+                meshVbo.draw(mode, f * faceVertices, faceVertices);
+            } else {
+                const float* data = indexed ? indexedMesh.vertices.data() : mesh.data();
+                glBegin(mode);
+                for (GLsizei i = 0; i < faceVertices; i++) {
+                    size_t vertex = static_cast<size_t>(f) * faceVertices + i;
+                    if (indexed) {
+                        vertex = indexedMesh.index(vertex);
+                    }
+                    glVertex3fv(data + vertex * FLOATS_PER_VERTEX);
+                }
+                glEnd();
+            }
+        }
+    }
+    if (reportStateChanges) {
+        // Setting mode, normal and color for each triangle, as the
+        // original drawTriangle() did, takes three calls per face
+        uint64_t perFace = 3 * NUM_FACES * meshLeaves;
+        std::cout << "State changes per frame: " << stateChanges
+                  << " (per-triangle state would take " << perFace << ")" << std::endl;
+        reportStateChanges = false;
+    }
+}
+
+/*
+ * Draw the point cloud: one batch per corner color, or the sorted
+ * splats in a single blended batch
+ */
+void drawCloud() {
+    if (splatMode) {
+        if (useVertexBuffers && !splatsUploaded) {
+            splatVbo.assign(splats);
+            splatsUploaded = true;
+        }
+        // Already back to front: blend without writing depth
+        glPointSize(splatSize);
+        glEnable(GL_POINT_SMOOTH);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+        if (useVertexBuffers) {
+            splatVbo.draw(GL_POINTS);
+        } else {
+            glBegin(GL_POINTS);
+            for (size_t i = 0; i < splats.size(); i += FLOATS_PER_SPLAT) {
+                glColor4fv(&splats[i + 3]);
+                glVertex3fv(&splats[i]);
+            }
+            glEnd();
+        }
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+        glDisable(GL_POINT_SMOOTH);
+        glPointSize(1.0f);
+        return;
+    }
+    
+    if (useVertexBuffers && !cloudUploaded) {
+        cloudVbo.assign(cloud);
+        cloudUploaded = true;
+    }
+    for (int k = 0; k < NUM_FACES; k++) {
+        glColor3fv(FACE_COLORS[k]);
+        GLsizei first = static_cast<GLsizei>(cloudSections[k]);
+        GLsizei count = static_cast<GLsizei>(cloudSections[k + 1] - cloudSections[k]);
+        if (useVertexBuffers) {
+            cloudVbo.draw(GL_POINTS, first, count);
+        } else {
+            glBegin(GL_POINTS);
+            for (GLsizei i = first; i < first + count; i++) {
+                glVertex3fv(&cloud[FLOATS_PER_VERTEX * i]);
+            }
+            glEnd();
         }
-        
-        // Recursively subdivide four corner tetrahedra
-        subdivideTetrahedron(a, ab, ac, ad, depth - 1);   // Top
-        subdivideTetrahedron(ab, b, bc, bd, depth - 1);   // Front
-        subdivideTetrahedron(ac, bc, c, cd, depth - 1);   // Left
-        subdivideTetrahedron(ad, bd, cd, d, depth - 1);   // Right
     }
 }
 
@@ -176,12 +840,36 @@ void subdivideTetrahedron(point3 a, point3 b, point3 c, point3 d, int depth) {
  * Display callback
  */
 void display() {
+    frameTimer.beginFrame();
+    
+    // Geometry only changes with the depth (or the pixel size or
+    // drawing method); a rotation reuses the cached mesh as is, except
+    // in level-of-detail mode. The point cloud only changes with the
+    // point count, its splat order with the rotation.
+    if (chaosMode) {
+        if (cloudPoints != chaosPoints) {
+            frameTimer.beginGeneration();
+            generateCloud();
+            frameTimer.endGeneration();
+        }
+        if (splatMode && !splatsCurrent()) {
+            frameTimer.beginGeneration();
+            sortSplats();
+            frameTimer.endGeneration();
+        }
+    } else if (!(meshKey == currentMeshKey())) {
+        frameTimer.beginGeneration();
+        buildMesh();
+        frameTimer.endGeneration();
+    }
+    
+    frameTimer.beginSubmission();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
     glLoadIdentity();
     
     // Position camera
-    gluLookAt(0.0, 0.0, 3.0,   // Eye position
+    gluLookAt(0.0, 0.0, EYE_DISTANCE,   // Eye position
               0.0, 0.0, 0.0,   // Look at point
               0.0, 1.0, 0.0);  // Up vector
     
@@ -190,24 +878,40 @@ void display() {
     glRotatef(rotationY, 0.0f, 1.0f, 0.0f);
     glRotatef(rotationZ, 0.0f, 0.0f, 1.0f);
     
-    // Scale to fit in view
-    glScalef(0.8f, 0.8f, 0.8f);
+    // Scale to fit in view, magnified about the zoom focus.
+    // Level-of-detail meshes are generated already scaled and moved.
+    if (chaosMode || !meshKey.lod) {
+        double center[3];
+        focus.viewCenter(zoom, center);
+        float scale = static_cast<float>(MODEL_SCALE * zoom);
+        glScalef(scale, scale, scale);
+        glTranslatef(static_cast<float>(-center[0]), static_cast<float>(-center[1]),
+                     static_cast<float>(-center[2]));
+    }
     
-    // Draw the 3D Sierpinski gasket
-    subdivideTetrahedron(vertices[0], vertices[1], vertices[2], vertices[3], subdivisionDepth);
+    if (chaosMode) {
+        drawCloud();
+    } else {
+        drawMesh();
+    }
     
-    glutSwapBuffers();
+    frameTimer.endSubmission();
+    frameTimer.endFrame();
+    if (!offscreen.enabled) {
+        glutSwapBuffers();
+    }
 }
 
 /*
- * Idle callback for animation
+ * Idle callback for animation, registered only while animating.
+ * Turns by the time the last frame took rather than a fixed step per
+ * call, so the speed does not depend on the frame rate.
  */
 void idle() {
-    if (animating) {
-        rotationY += animationSpeed;
-        if (rotationY > 360.0f) rotationY -= 360.0f;
-        glutPostRedisplay();
-    }
+    double step = std::min(frameTimer.frameDelta(), MAX_ANIMATION_STEP);
+    rotationY += animationSpeed * static_cast<float>(step);
+    if (rotationY > 360.0f) rotationY -= 360.0f;
+    glutPostRedisplay();
 }
 
 /*
@@ -220,7 +924,24 @@ void keyboard(unsigned char key, int x, int y) {
             break;
         case '+':
         case '=':
-            if (subdivisionDepth < MAX_DEPTH) {
+            if (chaosMode) {
+                if (2 * chaosPoints > MAX_CHAOS_POINTS) {
+                    std::cout << "Maximum point count reached (" << MAX_CHAOS_POINTS << ")" << std::endl;
+                } else if (!cloudWithinBudget(2 * chaosPoints)) {
+                    std::cout << 2 * chaosPoints << " points need "
+                              << cloudBytes(2 * chaosPoints) / (1024.0 * 1024.0)
+                              << " MB, over the " << memoryBudgetMB << " MB budget" << std::endl;
+                } else {
+                    chaosPoints *= 2;
+                    glutPostRedisplay();
+                }
+            } else if (subdivisionDepth >= maxDepth()) {
+                std::cout << "Maximum depth reached (" << maxDepth() << ")" << std::endl;
+            } else if (!withinBudget(subdivisionDepth + 1)) {
+                std::cout << "Depth " << subdivisionDepth + 1 << " needs "
+                          << meshBytes(subdivisionDepth + 1) / (1024.0 * 1024.0)
+                          << " MB, over the " << memoryBudgetMB << " MB budget" << std::endl;
+            } else {
                 subdivisionDepth++;
                 std::cout << "Subdivision depth: " << subdivisionDepth << std::endl;
                 glutPostRedisplay();
@@ -228,7 +949,12 @@ void keyboard(unsigned char key, int x, int y) {
             break;
         case '-':
         case '_':
-            if (subdivisionDepth > MIN_DEPTH) {
+            if (chaosMode) {
+                if (chaosPoints > 1) {
+                    chaosPoints /= 2;
+                    glutPostRedisplay();
+                }
+            } else if (subdivisionDepth > MIN_DEPTH) {
                 subdivisionDepth--;
                 std::cout << "Subdivision depth: " << subdivisionDepth << std::endl;
                 glutPostRedisplay();
@@ -236,6 +962,7 @@ void keyboard(unsigned char key, int x, int y) {
             break;
         case ' ':  // Space
             animating = !animating;
+            glutIdleFunc(animating ? idle : NULL);
             std::cout << "Animation: " << (animating ? "ON" : "OFF") << std::endl;
             break;
         case 'w':
@@ -249,17 +976,134 @@ void keyboard(unsigned char key, int x, int y) {
             rotationX = 30.0f;
             rotationY = 45.0f;
             rotationZ = 0.0f;
+            zoom = 1.0;
+            resetFocus();
+            updateVisibleDepth();
             animating = false;
-            std::cout << "Reset rotation" << std::endl;
+            glutIdleFunc(NULL);
+            std::cout << "Reset rotation, zoom and focus" << std::endl;
             glutPostRedisplay();
             break;
+        case 'v':
+        case 'V':
+            if (!vertexBuffersAvailable) {
+                std::cout << "Vertex buffers not supported" << std::endl;
+                break;
+            }
+            useVertexBuffers = !useVertexBuffers;
+            std::cout << "Drawing: " << (useVertexBuffers ? "Vertex buffer" : "Immediate mode") << std::endl;
+            glutPostRedisplay();
+            break;
+        case 'c':
+        case 'C':
+            cullSubpixel = !cullSubpixel;
+            // Full geometry may not fit: step back to a depth that does
+            fitDepthToBudget();
+            std::cout << "Sub-pixel culling: " << (cullSubpixel ? "ON" : "OFF") << std::endl;
+            glutPostRedisplay();
+            break;
+        case 'i':
+        case 'I':
+            if (!instancingAvailable) {
+                std::cout << "Instanced drawing needs OpenGL 3.3" << std::endl;
+                break;
+            }
+            useInstancing = !useInstancing;
+            fitDepthToBudget();
+            std::cout << "Drawing: " << (useInstancing ? "Instanced" : "Per-leaf vertices") << std::endl;
+            glutPostRedisplay();
+            break;
+        case 'x':
+        case 'X':
+            useIndexed = !useIndexed;
+            fitDepthToBudget();
+            std::cout << "Mesh: " << (useIndexed ? "Indexed (shared vertices)" : "Separate triangles")
+                      << std::endl;
+            glutPostRedisplay();
+            break;
+        case 'l':
+        case 'L':
+            lodMode = !lodMode;
+            if (subdivisionDepth > maxDepth()) {
+                subdivisionDepth = maxDepth();
+                std::cout << "Subdivision depth: " << subdivisionDepth << std::endl;
+            }
+            fitDepthToBudget();
+            fitZoomToMode();
+            std::cout << "Level of detail: " << (lodMode ? "ON" : "OFF") << std::endl;
+            glutPostRedisplay();
+            break;
+        case 'g':
+        case 'G':
+            if (!chaosMode && !cloudWithinBudget(chaosPoints)) {
+                std::cout << chaosPoints << " points need " << cloudBytes(chaosPoints) / (1024.0 * 1024.0)
+                          << " MB, over the " << memoryBudgetMB << " MB budget" << std::endl;
+                break;
+            }
+            chaosMode = !chaosMode;
+            fitZoomToMode();
+            std::cout << "Geometry: " << (chaosMode ? "Chaos-game point cloud" : "Subdivided mesh")
+                      << std::endl;
+            glutPostRedisplay();
+            break;
+        case 's':
+        case 'S':
+            splatMode = !splatMode;
+            if (splatMode && !cloudWithinBudget(chaosPoints)) {
+                std::cout << "Splats for " << chaosPoints << " points need "
+                          << cloudBytes(chaosPoints) / (1024.0 * 1024.0) << " MB, over the "
+                          << memoryBudgetMB << " MB budget" << std::endl;
+                splatMode = false;
+                break;
+            }
+            if (!splatMode) {
+                std::vector<float>().swap(splats);
+                splatsSorted = false;
+            }
+            std::cout << "Points: " << (splatMode ? "Depth-sorted splats" : "Single pixels") << std::endl;
+            glutPostRedisplay();
+            break;
+        case 'f':
+        case 'F':
+            frameTimer.toggleOverlay();
+            glutPostRedisplay();
+            break;
+    }
+}
+
+/*
+ * Shift + arrow keys: move the zoom focus by PAN_STEP of the view
+ * height across the screen
+ */
+void panView(int key) {
+    int right = key == GLUT_KEY_RIGHT ? 1 : key == GLUT_KEY_LEFT ? -1 : 0;
+    int up = key == GLUT_KEY_UP ? 1 : key == GLUT_KEY_DOWN ? -1 : 0;
+    if (right == 0 && up == 0) {
+        return;
     }
+    // Model-space length of the step at the focus's distance, along
+    // the screen axes (rows of the view rotation)
+    LodView view = currentLodView();
+    double length = PAN_STEP * 2.0 * view.tanY * EYE_DISTANCE / view.scale;
+    double step[3];
+    for (int i = 0; i < 3; i++) {
+        step[i] = length * (right * view.rotation[0][i] + up * view.rotation[1][i]);
+    }
+    focus.move(step);
+    updateVisibleDepth();
+    std::cout << "Focus: " << focus.hi[0] + focus.lo[0] << ", " << focus.hi[1] + focus.lo[1] << ", "
+              << focus.hi[2] + focus.lo[2] << std::endl;
+    glutPostRedisplay();
 }
 
 /*
  * Special key callback for arrow keys
  */
 void specialKeys(int key, int x, int y) {
+    if (glutGetModifiers() & GLUT_ACTIVE_SHIFT) {
+        panView(key);
+        return;
+    }
     switch (key) {
         case GLUT_KEY_UP:
             rotationX += 5.0f;
@@ -273,6 +1117,16 @@ void specialKeys(int key, int x, int y) {
         case GLUT_KEY_RIGHT:
             rotationY += 5.0f;
             break;
+        case GLUT_KEY_PAGE_UP:
+            zoom = std::min(maxZoom(), zoom * ZOOM_STEP);
+            updateVisibleDepth();
+            std::cout << "Zoom: " << zoom << std::endl;
+            break;
+        case GLUT_KEY_PAGE_DOWN:
+            zoom = std::max(MIN_ZOOM, zoom / ZOOM_STEP);
+            updateVisibleDepth();
+            std::cout << "Zoom: " << zoom << std::endl;
+            break;
     }
     glutPostRedisplay();
 }
@@ -282,29 +1136,284 @@ void specialKeys(int key, int x, int y) {
  */
 void reshape(int w, int h) {
     glViewport(0, 0, w, h);
+    windowWidth = w;
+    windowHeight = h;
+    updateVisibleDepth();
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
-    gluPerspective(60.0, (float)w / (float)h, 0.1, 100.0);
+    gluPerspective(FIELD_OF_VIEW, (float)w / (float)h, NEAR_PLANE, FAR_PLANE);
     glMatrixMode(GL_MODELVIEW);
 }
 
+/*
+ * Export mode: stream the depth-`subdivisionDepth` gasket to
+ * exportPath. Memory holds two chunks of the file, never the mesh.
+ */
+int runExport() {
+    initFaceNormals();
+    int depth = subdivisionDepth;
+    uint64_t triangles = NUM_FACES * tetrahedronCount(depth);
+    uint64_t fileBytes = exportFileBytes(exportFormat, triangles);
+    int chunkDepth = std::min(depth, EXPORT_CHUNK_DEPTH);
+    uint64_t chunks = tetrahedronCount(depth - chunkDepth);
+    uint64_t chunkTriangles = NUM_FACES * tetrahedronCount(chunkDepth);
+    
+    FILE* out = std::fopen(exportPath, "wb");
+    if (out == NULL) {
+        std::cerr << "Error: cannot open output file " << exportPath << std::endl;
+        return 1;
+    }
+    std::cout << "Exporting depth " << depth << ": " << triangles << " triangles, "
+              << fileBytes / (1024.0 * 1024.0) << " MB of " << exportFormatName(exportFormat)
+              << ", " << numThreads << " threads" << std::endl;
+    
+    auto start = std::chrono::steady_clock::now();
+    uint64_t written = 0;
+    bool ok = writeExportHeader(out, exportFormat, triangles, written) &&
+              streamExportChunks(out, chunks, [&](uint64_t chunk, std::vector<char>& bytes) {
+                  encodeExportChunk(vertices, faceNormals, exportFormat, depth, chunkDepth, chunk,
+                                    numThreads, bytes);
+              }, written);
+    if (ok && exportFormat == EXPORT_PLY) {
+        ok = streamExportChunks(out, chunks, [&](uint64_t chunk, std::vector<char>& bytes) {
+            encodePlyFaceChunk(chunk, chunkTriangles, bytes);
+        }, written);
+    }
+    ok = std::fclose(out) == 0 && ok;
+    if (!ok) {
+        std::cerr << "Error: write to " << exportPath << " failed" << std::endl;
+        return 1;
+    }
+    if (written != fileBytes) {
+        std::cerr << "Error: wrote " << written << " bytes, expected " << fileBytes << std::endl;
+        return 1;
+    }
+    
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Wrote " << exportPath << " in " << seconds << " s ("
+              << (seconds > 0.0 ? fileBytes / seconds / (1024.0 * 1024.0) : 0.0) << " MB/s)"
+              << std::endl;
+    
+    benchReport.addString("program", "gasket_3d_tetrahedron");
+    benchReport.addString("mode", "export");
+    benchReport.addString("format", exportFormatName(exportFormat));
+    benchReport.addInteger("depth", depth);
+    benchReport.addInteger("triangles", static_cast<long long>(triangles));
+    benchReport.addInteger("file_bytes", static_cast<long long>(fileBytes));
+    benchReport.addInteger("threads", numThreads);
+    benchReport.addNumber("export_ms", seconds * 1000.0);
+    benchReport.addRate("triangles_per_second", static_cast<double>(triangles), seconds * 1000.0);
+    benchReport.addPeakMemory();
+    return benchReport.write() ? 0 : 1;
+}
+
+/*
+ * Offscreen mode: draw the gasket at the start-up rotation --frames
+ * times into an offscreen framebuffer, with no window
+ */
+int runOffscreen() {
+    offscreen.defaultSize(WINDOW_WIDTH, WINDOW_HEIGHT);
+    int status = renderOffscreen(offscreen, frameTimer, false, []() {
+        initFaceNormals();
+        init();
+        reshape(offscreen.width, offscreen.height);
+    }, display);
+    if (status != 0) {
+        return status;
+    }
+
+    if (chaosMode) {
+        benchReport.addString("program", "gasket_3d_tetrahedron");
+        benchReport.addString("mode", "offscreen");
+        benchReport.addBool("chaos", true);
+        benchReport.addInteger("chaos_points", cloudPoints);
+        benchReport.addInteger("seed", static_cast<long long>(chaosSeed));
+        benchReport.addBool("splats", splatMode);
+        benchReport.addNumber("splat_size", splatSize);
+        benchReport.addInteger("cloud_bytes", static_cast<long long>(cloudBytes(cloudPoints)));
+        benchReport.addNumber("zoom", zoom);
+        benchReport.addBool("vertex_buffers", useVertexBuffers);
+        benchReport.addInteger("threads", numThreads);
+        benchReport.addInteger("width", offscreen.width);
+        benchReport.addInteger("height", offscreen.height);
+        benchReport.addFrameTimes(frameTimer);
+        benchReport.addRate("points_per_second", static_cast<double>(cloudPoints),
+                            frameTimer.stats(FrameTimer::GENERATION).total);
+        benchReport.addPeakMemory();
+        return benchReport.write() ? 0 : 1;
+    }
+
+    // Leaves are the tetrahedra actually generated and drawn
+    uint64_t leaves = meshLeaves;
+    size_t storedBytes = meshKey.instanced ? instances.size() * sizeof(float)
+                         : meshKey.indexed ? indexedMesh.bytes() : mesh.size() * sizeof(float);
+    benchReport.addString("program", "gasket_3d_tetrahedron");
+    benchReport.addString("mode", "offscreen");
+    benchReport.addBool("chaos", false);
+    benchReport.addInteger("depth", subdivisionDepth);
+    benchReport.addInteger("leaf_depth", meshKey.lod ? lod.deepest : meshKey.leafDepth);
+    benchReport.addInteger("leaves", static_cast<long long>(leaves));
+    benchReport.addBool("points", meshPoints);
+    benchReport.addInteger("mesh_bytes", static_cast<long long>(storedBytes));
+    benchReport.addBool("instanced", meshKey.instanced);
+    benchReport.addBool("indexed", meshKey.indexed);
+    benchReport.addBool("lod", meshKey.lod);
+    benchReport.addNumber("lod_pixels", lodPixels);
+    benchReport.addNumber("zoom", zoom);
+    benchReport.addBool("vertex_buffers", useVertexBuffers);
+    benchReport.addInteger("threads", numThreads);
+    benchReport.addInteger("width", offscreen.width);
+    benchReport.addInteger("height", offscreen.height);
+    benchReport.addFrameTimes(frameTimer);
+    benchReport.addRate("leaves_per_second", static_cast<double>(leaves),
+                        frameTimer.stats(FrameTimer::GENERATION).total);
+    benchReport.addPeakMemory();
+    return benchReport.write() ? 0 : 1;
+}
+
+/*
+ * Parse command line options. Unrecognized arguments are left for
+ * glutInit().
+ */
+bool parseArguments(int argc, char** argv) {
+    resetFocus();
+    for (int i = 1; i < argc; i++) {
+        if (offscreen.parse(argc, argv, i) || benchReport.parse(argc, argv, i)) {
+            continue;
+        }
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--immediate") == 0) {
+            useVertexBuffers = false;
+        } else if (std::strcmp(argv[i], "--depth") == 0 && hasValue) {
+            subdivisionDepth = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--memory-budget") == 0 && hasValue) {
+            memoryBudgetMB = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--no-cull") == 0) {
+            cullSubpixel = false;
+        } else if (std::strcmp(argv[i], "--indexed") == 0) {
+            useIndexed = true;
+        } else if (std::strcmp(argv[i], "--instanced") == 0) {
+            useInstancing = true;
+        } else if (std::strcmp(argv[i], "--export") == 0 && hasValue) {
+            exportPath = argv[++i];
+            if (!exportFormatFromPath(exportPath, exportFormat)) {
+                std::cerr << "Error: --export needs a .stl or .ply file name" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--lod") == 0 && hasValue) {
+            lodMode = true;
+            lodPixels = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--zoom") == 0 && hasValue) {
+            zoom = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--focus") == 0 && hasValue) {
+            const char* value = argv[++i];
+            if (std::sscanf(value, "%lf,%lf,%lf", &focus.hi[0], &focus.hi[1], &focus.hi[2]) != 3) {
+                std::cerr << "Error: --focus needs X,Y,Z" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--chaos") == 0 && hasValue) {
+            chaosMode = true;
+            chaosPoints = static_cast<long long>(std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--splats") == 0 && hasValue) {
+            splatMode = true;
+            splatSize = static_cast<float>(std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--seed") == 0 && hasValue) {
+            chaosSeed = std::strtoull(argv[++i], NULL, 10);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+            numThreads = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--frame-csv") == 0 && hasValue) {
+            const char* path = argv[++i];
+            if (!frameTimer.openCsv(path)) {
+                std::cerr << "Error: cannot write " << path << std::endl;
+                return false;
+            }
+        }
+    }
+    if (numThreads <= 0) {
+        numThreads = static_cast<int>(std::thread::hardware_concurrency());
+        if (numThreads < 1) numThreads = 1;
+    }
+    if (lodMode && lodPixels <= 0.0) {
+        std::cerr << "Error: --lod needs a positive pixel size" << std::endl;
+        return false;
+    }
+    if (zoom < MIN_ZOOM || zoom > maxZoom()) {
+        std::cerr << "Error: --zoom must be between " << MIN_ZOOM << " and " << maxZoom()
+                  << " (up to " << MAX_ZOOM << " with --lod, without --chaos)" << std::endl;
+        return false;
+    }
+    if (chaosPoints < 1 || chaosPoints > MAX_CHAOS_POINTS) {
+        std::cerr << "Error: --chaos must be between 1 and " << MAX_CHAOS_POINTS << " points" << std::endl;
+        return false;
+    }
+    if (splatMode && splatSize <= 0.0f) {
+        std::cerr << "Error: --splats needs a positive pixel size" << std::endl;
+        return false;
+    }
+    updateVisibleDepth();
+    if (subdivisionDepth < MIN_DEPTH || subdivisionDepth > maxDepth()) {
+        std::cerr << "Error: --depth must be between " << MIN_DEPTH << " and "
+                  << maxDepth() << (lodMode ? "" : " (" + std::to_string(LOD_MAX_DEPTH) + " with --lod)")
+                  << std::endl;
+        return false;
+    }
+    if (exportPath != NULL) {
+        // Streamed, so only the formats' triangle count limits the depth
+        if (NUM_FACES * tetrahedronCount(subdivisionDepth) > EXPORT_MAX_TRIANGLES) {
+            std::cerr << "Error: depth " << subdivisionDepth << " has too many triangles for "
+                      << exportFormatName(exportFormat) << " (32-bit counts)" << std::endl;
+            return false;
+        }
+        return true;
+    }
+    if (chaosMode) {
+        // No mesh is built, only the cloud
+        if (!cloudWithinBudget(chaosPoints)) {
+            std::cerr << "Error: " << chaosPoints << " points need "
+                      << cloudBytes(chaosPoints) / (1024.0 * 1024.0) << " MB, over the "
+                      << memoryBudgetMB << " MB budget (see --memory-budget)" << std::endl;
+            return false;
+        }
+        return true;
+    }
+    if (!withinBudget(subdivisionDepth)) {
+        std::cerr << "Error: depth " << subdivisionDepth << " needs "
+                  << meshBytes(subdivisionDepth) / (1024.0 * 1024.0) << " MB, over the "
+                  << memoryBudgetMB << " MB budget (see --memory-budget)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
 /*
  * Main function
  */
 int main(int argc, char** argv) {
+    if (!parseArguments(argc, argv)) {
+        return 1;
+    }
+    if (exportPath != NULL) {
+        return runExport();
+    }
+    if (offscreen.enabled) {
+        return runOffscreen();
+    }
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
     glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
     glutInitWindowPosition(100, 100);
     glutCreateWindow("Sierpinski Gasket - 3D Tetrahedron Method");
     
+    initFaceNormals();
     init();
     
     glutDisplayFunc(display);
     glutKeyboardFunc(keyboard);
     glutSpecialFunc(specialKeys);
     glutReshapeFunc(reshape);
-    glutIdleFunc(idle);
+    if (animating) {
+        glutIdleFunc(idle);
+    }
     
     glutMainLoop();
     return 0;
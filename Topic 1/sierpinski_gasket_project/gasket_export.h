@@ -0,0 +1,81 @@
+/*
+ * gasket_export.h - The 3D gasket in chunks for mesh_export.h
+ *
+ * The gasket is exported one subtree at a time: chunk k of a depth-n
+ * gasket is the subtree reached by the base-4 digits of k, of depth
+ * chunkDepth. encodeExportChunk() generates it with
+ * subdivideTetrahedron() (split over several threads) and encodes its
+ * triangles straight into the chunk's bytes, ready for
+ * streamExportChunks().
+ */
+
+#ifndef GASKET_EXPORT_H
+#define GASKET_EXPORT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "mesh_export.h"
+#include "tetrahedron_subdivision.h"
+
+// Depth of the subtree generated per export chunk: 4^7 tetrahedra,
+// 3.3 MB of STL
+const int EXPORT_CHUNK_DEPTH = 7;
+
+/*
+ * Encode the triangles of subtree `chunk` (of depth chunkDepth) of a
+ * depth-`depth` gasket on `corners` into bytes: STL records (with the
+ * face normals), or the PLY vertices. The subtree is split over
+ * `threads` threads; triangles come out tetrahedron by tetrahedron,
+ * faces in FACES order, for any thread count.
+ */
+inline void encodeExportChunk(const point3 corners[4], const float normals[NUM_FACES][3],
+                              MeshExportFormat format, int depth, int chunkDepth, uint64_t chunk,
+                              int threads, std::vector<char>& bytes) {
+    point3 root[4];
+    std::copy(&corners[0][0], &corners[0][0] + 12, &root[0][0]);
+    descendTetrahedron(root, chunk, depth - chunkDepth);
+
+    uint64_t triangleBytes = format == EXPORT_STL ? STL_TRIANGLE_BYTES : PLY_TRIANGLE_VERTEX_BYTES;
+    bytes.resize(tetrahedronCount(chunkDepth) * NUM_FACES * triangleBytes);
+    int split = subdivisionSplitDepth(chunkDepth, 4, threads);
+    uint64_t taskLeaves = tetrahedronCount(chunkDepth - split);
+    runSubdivisionTasks(tetrahedronCount(split), threads, [&](uint64_t task) {
+        point3 t[4];
+        std::copy(&root[0][0], &root[0][0] + 12, &t[0][0]);
+        descendTetrahedron(t, task, split);
+
+        // Generate the subtree into face sections, then interleave them
+        size_t sectionFloats = faceSectionFloats(chunkDepth - split, false);
+        std::vector<float> faces(NUM_FACES * sectionFloats);
+        float* out[NUM_FACES];
+        for (int f = 0; f < NUM_FACES; f++) {
+            out[f] = faces.data() + f * sectionFloats;
+        }
+        subdivideTetrahedron(t[0], t[1], t[2], t[3], chunkDepth - split, false, out);
+
+        char* record = bytes.data() + task * taskLeaves * NUM_FACES * triangleBytes;
+        for (uint64_t leaf = 0; leaf < taskLeaves; leaf++) {
+            for (int f = 0; f < NUM_FACES; f++) {
+                const float* triangle = faces.data() + f * sectionFloats + leaf * 3 * FLOATS_PER_VERTEX;
+                record = format == EXPORT_STL ? encodeStlTriangle(normals[f], triangle, record)
+                                              : encodePlyVertices(triangle, record);
+            }
+        }
+    });
+}
+
+/*
+ * Encode the PLY faces of chunk `chunk` (chunkTriangles triangles per
+ * chunk) into bytes. Faces only refer to the vertices by number, so no
+ * geometry is needed.
+ */
+inline void encodePlyFaceChunk(uint64_t chunk, uint64_t chunkTriangles, std::vector<char>& bytes) {
+    bytes.resize(chunkTriangles * PLY_FACE_BYTES);
+    char* record = bytes.data();
+    for (uint64_t i = 0; i < chunkTriangles; i++) {
+        record = encodePlyFace(chunk * chunkTriangles + i, record);
+    }
+}
+
+#endif // GASKET_EXPORT_H
@@ -0,0 +1,172 @@
+/*
+ * gasket_geometry.h - Exact size of the gaskets at every depth
+ *
+ * How much geometry a depth produces is known before generating any
+ * of it. GASKET_2D_LEVELS and GASKET_3D_LEVELS hold, for every depth,
+ * computed at compile time:
+ *
+ *   leaves          leaf triangles (2D, 3^n) or tetrahedra (3D, 4^n)
+ *   triangles       triangles drawn: one per leaf in 2D, four in 3D
+ *   sharedVertices  distinct corner points, each counted once even
+ *                   where leaves touch: (3^(n+1) + 3) / 2 in 2D,
+ *                   2 * 4^n + 2 in 3D
+ *   measure         area (2D, (3/4)^n) or volume (3D, (1/2)^n) that
+ *                   is left, as a fraction of the original shape
+ *
+ * The tables are built from the subdivision step itself (three half
+ * size copies sharing three midpoints in 2D, four sharing six edge
+ * midpoints in 3D) and checked against the closed forms above by
+ * static_assert, so a mistake in either fails to compile.
+ *
+ * gasketMeshFloats() / gasketMeshBytes() give the exact buffer size of
+ * each mesh format, so the programs size their output once and refuse
+ * a depth over their memory budget before allocating anything.
+ * Counts that do not fit in 64 bits saturate at UINT64_MAX.
+ */
+
+#ifndef GASKET_GEOMETRY_H
+#define GASKET_GEOMETRY_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "subdivision.h"
+
+// Deepest 3D level with 4^depth tetrahedra in 64 bits
+const int TETRAHEDRON_MAX_LEVELS = 31;
+
+struct GasketLevel {
+    uint64_t leaves;
+    uint64_t triangles;
+    uint64_t sharedVertices;
+    double measure;
+};
+
+/*
+ * a * b, or UINT64_MAX if that does not fit
+ */
+constexpr uint64_t saturatingMultiply(uint64_t a, uint64_t b) {
+    return a != 0 && b > UINT64_MAX / a ? UINT64_MAX : a * b;
+}
+
+/*
+ * Number of leaf tetrahedra at the given depth: 4^depth
+ */
+constexpr uint64_t tetrahedronCount(int depth) {
+    return static_cast<uint64_t>(1) << (2 * depth);
+}
+
+/*
+ * Sizes of levels 0 to Levels - 1 of a gasket whose every leaf is
+ * replaced by `copies` half-size copies sharing `sharedPerStep` of
+ * their corners, starting from one shape with `corners` corners and
+ * `faces` triangles
+ */
+template <int Levels>
+constexpr std::array<GasketLevel, Levels> gasketLevels(uint64_t copies, uint64_t sharedPerStep,
+                                                       uint64_t corners, uint64_t faces,
+                                                       double measureFactor) {
+    std::array<GasketLevel, Levels> levels{};
+    GasketLevel level = {1, faces, corners, 1.0};
+    for (int depth = 0; depth < Levels; depth++) {
+        levels[depth] = level;
+        level.leaves = saturatingMultiply(level.leaves, copies);
+        level.triangles = saturatingMultiply(level.triangles, copies);
+        level.sharedVertices = saturatingMultiply(level.sharedVertices, copies) - sharedPerStep;
+        level.measure *= measureFactor;
+    }
+    return levels;
+}
+
+constexpr std::array<GasketLevel, SUBDIVISION_MAX_LEVELS + 1> GASKET_2D_LEVELS =
+    gasketLevels<SUBDIVISION_MAX_LEVELS + 1>(3, 3, 3, 1, 0.75);
+
+constexpr std::array<GasketLevel, TETRAHEDRON_MAX_LEVELS + 1> GASKET_3D_LEVELS =
+    gasketLevels<TETRAHEDRON_MAX_LEVELS + 1>(4, 6, 4, 4, 0.5);
+
+/*
+ * Do both tables match the closed forms for every depth?
+ */
+constexpr bool gasketLevelsMatchClosedForms() {
+    double measure = 1.0;
+    for (int depth = 0; depth <= SUBDIVISION_MAX_LEVELS; depth++) {
+        const GasketLevel& level = GASKET_2D_LEVELS[depth];
+        uint64_t leaves = gasketTriangleCount(depth);
+        if (level.leaves != leaves || level.triangles != leaves ||
+            level.sharedVertices != (3 * leaves + 3) / 2 || level.measure != measure) {
+            return false;
+        }
+        measure *= 0.75;
+    }
+    measure = 1.0;
+    for (int depth = 0; depth <= TETRAHEDRON_MAX_LEVELS; depth++) {
+        const GasketLevel& level = GASKET_3D_LEVELS[depth];
+        uint64_t leaves = tetrahedronCount(depth);
+        if (level.leaves != leaves || level.triangles != saturatingMultiply(4, leaves) ||
+            level.sharedVertices != 2 * leaves + 2 || level.measure != measure) {
+            return false;
+        }
+        measure *= 0.5;
+    }
+    return true;
+}
+
+static_assert(gasketLevelsMatchClosedForms(),
+              "gasket size tables disagree with the closed-form counts");
+static_assert(GASKET_2D_LEVELS[2].sharedVertices == 15 && GASKET_3D_LEVELS[1].sharedVertices == 10,
+              "gasket size tables are wrong for small depths");
+
+// What a mesh stores for each leaf
+enum GasketMeshFormat {
+    MESH_TRIANGLES_2D,      // three x, y corners
+    MESH_CENTROIDS_2D,      // x, y centroid of a sub-pixel leaf
+    MESH_TRIANGLES_3D,      // four faces of three x, y, z corners
+    MESH_FACE_POINTS_3D,    // one x, y, z point per face of a sub-pixel leaf
+    MESH_INSTANCES_3D       // x, y, z offset and scale (instanced_mesh.h)
+};
+
+// Floats per leaf of each format
+constexpr int MESH_FLOATS_PER_LEAF[] = {FLOATS_PER_TRIANGLE_2D, FLOATS_PER_POINT_2D, 4 * 3 * 3,
+                                        4 * 3, 4};
+
+constexpr bool isMeshFormat3D(GasketMeshFormat format) {
+    return format >= MESH_TRIANGLES_3D;
+}
+
+/*
+ * Floats of a depth-`depth` mesh in the given format, or UINT64_MAX
+ * if the depth is beyond the table
+ */
+constexpr uint64_t gasketMeshFloats(GasketMeshFormat format, int depth) {
+    int maxDepth = isMeshFormat3D(format) ? TETRAHEDRON_MAX_LEVELS : SUBDIVISION_MAX_LEVELS;
+    if (depth < 0 || depth > maxDepth) {
+        return UINT64_MAX;
+    }
+    uint64_t leaves = isMeshFormat3D(format) ? GASKET_3D_LEVELS[depth].leaves
+                                             : GASKET_2D_LEVELS[depth].leaves;
+    return saturatingMultiply(leaves, MESH_FLOATS_PER_LEAF[format]);
+}
+
+constexpr uint64_t gasketMeshBytes(GasketMeshFormat format, int depth) {
+    return saturatingMultiply(gasketMeshFloats(format, depth), sizeof(float));
+}
+
+static_assert(gasketMeshBytes(MESH_TRIANGLES_2D, 10) == 59049ull * 6 * 4,
+              "2D mesh size is wrong");
+static_assert(gasketMeshBytes(MESH_TRIANGLES_3D, 31) == UINT64_MAX,
+              "3D mesh size does not saturate");
+
+/*
+ * Give mesh exactly `size` elements for a new mesh, allocating once.
+ * The old contents are released first instead of being copied, so the
+ * old and new meshes are never held at the same time.
+ */
+template <typename T>
+inline void allocateMesh(std::vector<T>& mesh, uint64_t size) {
+    if (mesh.capacity() != size) {
+        std::vector<T>().swap(mesh);
+    }
+    mesh.resize(static_cast<size_t>(size));
+}
+
+#endif // GASKET_GEOMETRY_H
@@ -0,0 +1,511 @@
+/*
+ * ifs_engine.h - Chaos game for general iterated function systems
+ *
+ * The Sierpinski gasket is the attractor of three maps, each moving a
+ * point halfway to one corner, picked with equal probability. Any set
+ * of contracting affine maps has an attractor the same chaos game
+ * draws. An IfsSystem holds up to IFS_MAX_MAPS maps in 2D or 3D, each
+ * with its own probability: the Barnsley fern, the Sierpinski carpet,
+ * the tetrahedral gasket, or maps read from a file (loadIfsFile()).
+ *
+ * Maps are picked with an alias table (Vose's method): 32 random bits
+ * pick a column uniformly and decide between the column's own map and
+ * its alias, so one 64-bit draw gives two choices. The decision is
+ * mask arithmetic rather than a branch, so picking costs the same for
+ * any number of maps and any probabilities, however uneven.
+ *
+ * ParallelIfs runs the system on the threading of chaos_game.h (one
+ * chain per thread, seeded by jump()) with the SIMD kernels of
+ * ifs_kernels.h, so it plugs into everything that takes a
+ * ChaosGenerator: point streams, progressive drawing and the density
+ * histogram.
+ *
+ * File format for loadIfsFile(), one map per line, '#' starts a
+ * comment:
+ *
+ *   2D:  a b c d e f p            x' = a x + b y + e, y' = c x + d y + f
+ *   3D:  m11 .. m33 t1 t2 t3 p    p' = M p + t, M row by row
+ *
+ * p is the map's relative weight; weights need not add up to 1. Every
+ * map must be a contraction (linearNorm() of M below 1), or the points
+ * run off to infinity.
+ */
+
+#ifndef IFS_ENGINE_H
+#define IFS_ENGINE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "prng.h"
+#include "chaos_game.h"
+#include "ifs_kernels.h"
+
+/*
+ * Constant-time sampling of a discrete distribution (Vose's alias
+ * method)
+ */
+class AliasTable {
+public:
+    AliasTable() : columns(0) {}
+
+    /*
+     * weights: relative probability of each outcome (at most 256,
+     * all positive)
+     */
+    explicit AliasTable(const std::vector<double>& weights)
+        : columns(weights.size()), entries(weights.size()) {
+        double total = 0.0;
+        for (double w : weights) {
+            total += w;
+        }
+        // Each column holds probability 1 / n: its own share scaled to
+        // [0, 1], topped up from a larger outcome
+        std::vector<double> scaled(columns);
+        std::vector<int> small, large;
+        for (size_t i = 0; i < columns; i++) {
+            scaled[i] = weights[i] * columns / total;
+            (scaled[i] < 1.0 ? small : large).push_back(static_cast<int>(i));
+        }
+        while (!small.empty() && !large.empty()) {
+            int s = small.back();
+            int l = large.back();
+            small.pop_back();
+            setColumn(s, scaled[s], l);
+            scaled[l] -= 1.0 - scaled[s];
+            if (scaled[l] < 1.0) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        // Rounding leaves columns whose share is 1
+        for (int i : small) {
+            setColumn(i, 1.0, i);
+        }
+        for (int i : large) {
+            setColumn(i, 1.0, i);
+        }
+    }
+
+    size_t size() const {
+        return columns;
+    }
+
+    // One outcome (uses the low half of a draw, as fill() does for
+    // its first choice)
+    template <typename Rng>
+    int next(Rng& rng) const {
+        return pick(entries.data(), columns, static_cast<uint32_t>(rng.next()));
+    }
+
+    // Fill out[0..count) with outcomes, two per 64-bit draw
+    template <typename Rng>
+    void fill(Rng& rng, uint8_t* out, size_t count) const {
+        // Locals, as stores through out may alias the members
+        const uint64_t* table = entries.data();
+        const uint64_t n = columns;
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2) {
+            uint64_t draw = rng.next();
+            out[i] = pick(table, n, static_cast<uint32_t>(draw));
+            out[i + 1] = pick(table, n, static_cast<uint32_t>(draw >> 32));
+        }
+        if (i < count) {
+            out[i] = static_cast<uint8_t>(next(rng));
+        }
+    }
+
+private:
+    uint64_t columns;
+    // Per column: threshold in the high 32 bits, alias in the low 8
+    std::vector<uint64_t> entries;
+
+    /*
+     * Outcome for 32 random bits. bits * columns splits into the column
+     * (high half) and a fraction that is uniform within the column up
+     * to a step of columns / 2^32 (low half). The column's own outcome
+     * is kept where the fraction is below its threshold: the compare
+     * becomes an all-ones or zero mask that selects between column and
+     * alias.
+     */
+    static uint8_t pick(const uint64_t* table, uint64_t n, uint32_t bits) {
+        uint64_t product = static_cast<uint64_t>(bits) * n;
+        uint32_t column = static_cast<uint32_t>(product >> 32);
+        uint32_t fraction = static_cast<uint32_t>(product);
+        uint64_t entry = table[column];
+        uint32_t alias = static_cast<uint32_t>(entry & 0xFF);
+        uint32_t own = 0u - static_cast<uint32_t>(fraction < static_cast<uint32_t>(entry >> 32));
+        return static_cast<uint8_t>(alias ^ ((alias ^ column) & own));
+    }
+
+    void setColumn(int i, double share, int other) {
+        double bound = std::floor(share * 4294967296.0 + 0.5);
+        if (bound >= 4294967296.0) {
+            // Always the column's own outcome
+            entries[i] = 0xFFFFFFFF00000000ull | static_cast<uint64_t>(i);
+        } else {
+            entries[i] = static_cast<uint64_t>(bound) << 32 | static_cast<uint64_t>(other);
+        }
+    }
+};
+
+/*
+ * Affine maps of a 2D or 3D iterated function system
+ */
+struct IfsSystem {
+    int dimensions;
+    std::vector<float> coefficients;    // per map: M row by row, then t
+    std::vector<double> weights;        // relative probability of each map
+
+    IfsSystem() : dimensions(2) {}
+
+    int mapCount() const {
+        return static_cast<int>(weights.size());
+    }
+
+    int coefficientsPerMap() const {
+        return dimensions * (dimensions + 1);
+    }
+
+    void addMap(const float* mapCoefficients, double weight) {
+        coefficients.insert(coefficients.end(), mapCoefficients,
+                            mapCoefficients + coefficientsPerMap());
+        weights.push_back(weight);
+    }
+
+    /*
+     * Map moving a point `ratio` of the way to `target`, in all
+     * dimensions: p' = (1 - ratio) p + ratio target
+     */
+    void addContraction(const float* target, float ratio, double weight) {
+        float map[12] = {};
+        for (int r = 0; r < dimensions; r++) {
+            map[r * dimensions + r] = 1.0f - ratio;
+            map[dimensions * dimensions + r] = ratio * target[r];
+        }
+        addMap(map, weight);
+    }
+
+    template <int Dims>
+    IfsTables<Dims> tables() const {
+        IfsTables<Dims> result = {};
+        for (int m = 0; m < mapCount(); m++) {
+            for (int k = 0; k < IfsTables<Dims>::COEFFICIENTS; k++) {
+                result.coefficient[k][m] = coefficients[m * IfsTables<Dims>::COEFFICIENTS + k];
+            }
+        }
+        return result;
+    }
+};
+
+// Names accepted by ifsPreset()
+const char* const IFS_PRESET_NAMES = "gasket, carpet, fern, tetrahedron";
+
+/*
+ * Built-in systems. Returns false for an unknown name.
+ */
+inline bool ifsPreset(const char* name, IfsSystem& system) {
+    system = IfsSystem();
+    if (std::strcmp(name, "gasket") == 0) {
+        // The three-vertex chaos game of gasket_2d_random
+        const float corners[3][2] = {{-0.9f, -0.9f}, {0.9f, -0.9f}, {0.0f, 0.9f}};
+        for (const float* corner : corners) {
+            system.addContraction(corner, 0.5f, 1.0);
+        }
+    } else if (std::strcmp(name, "carpet") == 0) {
+        // Eight thirds of the square, all but the centre
+        for (int i = -1; i <= 1; i++) {
+            for (int j = -1; j <= 1; j++) {
+                const float corner[2] = {0.9f * i, 0.9f * j};
+                if (i != 0 || j != 0) {
+                    system.addContraction(corner, 2.0f / 3.0f, 1.0);
+                }
+            }
+        }
+    } else if (std::strcmp(name, "fern") == 0) {
+        // Barnsley's fern: stem, successively smaller leaflets, and
+        // the largest left and right leaflets
+        const float maps[4][6] = {
+            {0.0f, 0.0f, 0.0f, 0.16f, 0.0f, 0.0f},
+            {0.85f, 0.04f, -0.04f, 0.85f, 0.0f, 1.6f},
+            {0.2f, -0.26f, 0.23f, 0.22f, 0.0f, 1.6f},
+            {-0.15f, 0.28f, 0.26f, 0.24f, 0.0f, 0.44f}
+        };
+        const double weights[4] = {0.01, 0.85, 0.07, 0.07};
+        for (int m = 0; m < 4; m++) {
+            system.addMap(maps[m], weights[m]);
+        }
+    } else if (std::strcmp(name, "tetrahedron") == 0) {
+        // The 3D gasket, on the corners of gasket_3d_tetrahedron
+        system.dimensions = 3;
+        const float corners[4][3] = {
+            {0.0f, 1.0f, 0.0f}, {0.0f, -0.5f, 0.866f},
+            {-0.866f, -0.5f, -0.433f}, {0.866f, -0.5f, -0.433f}
+        };
+        for (const float* corner : corners) {
+            system.addContraction(corner, 0.5f, 1.0);
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Largest singular value of the dimensions x dimensions matrix m (row
+ * by row): the most the map stretches any vector. It is the square
+ * root of the largest eigenvalue of the symmetric matrix M^T M, found in
+ * closed form (2D matrices are padded to 3D with zeros).
+ */
+inline double linearNorm(const float* m, int dimensions) {
+    double a[3][3] = {};
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            for (int k = 0; k < dimensions && r < dimensions && c < dimensions; k++) {
+                a[r][c] += static_cast<double>(m[k * dimensions + r]) * m[k * dimensions + c];
+            }
+        }
+    }
+    double offDiagonal = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+    double q = (a[0][0] + a[1][1] + a[2][2]) / 3.0;
+    double spread = (a[0][0] - q) * (a[0][0] - q) + (a[1][1] - q) * (a[1][1] - q) +
+                    (a[2][2] - q) * (a[2][2] - q) + 2.0 * offDiagonal;
+    double p = std::sqrt(spread / 6.0);
+    if (p == 0.0) {
+        // A multiple of the identity
+        return std::sqrt(q);
+    }
+    // Eigenvalues are q + 2 p cos(phi + 2 pi k / 3), phi from det((A - qI) / p)
+    double b[3][3];
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            b[r][c] = (a[r][c] - (r == c ? q : 0.0)) / p;
+        }
+    }
+    double det = b[0][0] * (b[1][1] * b[2][2] - b[1][2] * b[2][1]) -
+                 b[0][1] * (b[1][0] * b[2][2] - b[1][2] * b[2][0]) +
+                 b[0][2] * (b[1][0] * b[2][1] - b[1][1] * b[2][0]);
+    double phi = std::acos(std::max(-1.0, std::min(1.0, det / 2.0))) / 3.0;
+    return std::sqrt(std::max(0.0, q + 2.0 * p * std::cos(phi)));
+}
+
+/*
+ * Read a system from path (see the format above). On failure returns
+ * false with the reason in error.
+ */
+inline bool loadIfsFile(const char* path, IfsSystem& system, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = std::string("cannot read ") + path;
+        return false;
+    }
+    system = IfsSystem();
+    system.dimensions = 0;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::vector<double> values;
+        double value;
+        while (fields >> value) {
+            values.push_back(value);
+        }
+        if (!fields.eof()) {
+            error = "line " + std::to_string(lineNumber) + ": not a number";
+            return false;
+        }
+        if (values.empty()) {
+            continue;
+        }
+        int dimensions = values.size() == 7 ? 2 : values.size() == 13 ? 3 : 0;
+        if (dimensions == 0 || (system.dimensions != 0 && dimensions != system.dimensions)) {
+            error = "line " + std::to_string(lineNumber) + ": expected " +
+                    (system.dimensions == 3 ? "13" : system.dimensions == 2 ? "7" : "7 or 13") +
+                    " numbers";
+            return false;
+        }
+        if (values.back() <= 0.0) {
+            error = "line " + std::to_string(lineNumber) + ": weight must be positive";
+            return false;
+        }
+        system.dimensions = dimensions;
+        float map[12];
+        bool finite = true;
+        for (size_t k = 0; k + 1 < values.size(); k++) {
+            map[k] = static_cast<float>(values[k]);
+            finite = finite && std::isfinite(map[k]);
+        }
+        double norm = finite ? linearNorm(map, dimensions) : 0.0;
+        if (!finite || !(norm < 1.0)) {
+            std::ostringstream message;
+            message << "line " << lineNumber << ": not a contraction ";
+            if (finite) {
+                message << "(the map stretches by up to " << norm << "; must be below 1)";
+            } else {
+                message << "(coefficients must be finite floats)";
+            }
+            error = message.str();
+            return false;
+        }
+        system.addMap(map, values.back());
+    }
+    if (system.mapCount() == 0 || system.mapCount() > IFS_MAX_MAPS) {
+        error = "expected 1 to " + std::to_string(IFS_MAX_MAPS) + " maps, found " +
+                std::to_string(system.mapCount());
+        return false;
+    }
+    return true;
+}
+
+/*
+ * The chains owned by one worker thread, as ChaosChain: CHAOS_MAX_LANES
+ * chains run `lanes` at a time by the kernel, maps drawn in whole
+ * blocks from the worker's random stream and used up row by row
+ */
+template <typename Rng, int Dims>
+struct IfsChain {
+    // Map choices drawn per kernel call
+    static const int BLOCK_CHOICES = 4096;
+
+    // Floats per point
+    static const int DIMENSIONS = Dims;
+
+    Rng rng;
+    AliasTable picker;
+    typename IfsKernel<Dims>::Function kernel;
+    int lanes;      // chains per kernel call, a divisor of CHAOS_MAX_LANES
+    IfsTables<Dims> tables;
+    float lanePoints[Dims * CHAOS_MAX_LANES];
+    std::vector<uint8_t> choices;
+    size_t nextChoice;      // first unused choice in choices
+    float pending[Dims * CHAOS_MAX_LANES];  // last row, if a call ended inside it
+    int pendingPoints;      // points at the end of pending not handed out yet
+
+    IfsChain(const Rng& generator, const IfsSystem& system, ChaosKernelKind kind)
+        : rng(generator), picker(system.weights), tables(system.tables<Dims>()), choices(BLOCK_CHOICES),
+          nextChoice(BLOCK_CHOICES), pendingPoints(0) {
+        kind = resolveIfsKernel(kind, system.mapCount());
+        kernel = ifsKernelFunction<Dims>(kind);
+        lanes = chaosKernelLanes(kind);
+        for (int i = 0; i < Dims * CHAOS_MAX_LANES; i++) {
+            lanePoints[i] = 0.0f;
+        }
+    }
+
+    // Advance every chain count steps without storing (burn-in)
+    void discard(long long count) {
+        float scratch[Dims * CHAOS_MAX_LANES];
+        for (long long i = 0; i < count; i++) {
+            advanceRows(scratch, 1);
+        }
+    }
+
+    // Store count interleaved points (Dims floats each) into out
+    void generate(float* out, long long count) {
+        // The rest of the row the previous call stopped inside
+        long long n = std::min<long long>(count, pendingPoints);
+        const float* rest = pending + Dims * (CHAOS_MAX_LANES - pendingPoints);
+        std::copy(rest, rest + Dims * n, out);
+        pendingPoints -= static_cast<int>(n);
+        out += Dims * n;
+        count -= n;
+
+        long long rows = count / CHAOS_MAX_LANES;
+        advanceRows(out, rows);
+        out += Dims * rows * CHAOS_MAX_LANES;
+        count -= rows * CHAOS_MAX_LANES;
+
+        // Fewer points left than chains: keep the rest of one more row
+        if (count > 0) {
+            advanceRows(pending, 1);
+            std::copy(pending, pending + Dims * count, out);
+            pendingPoints = CHAOS_MAX_LANES - static_cast<int>(count);
+        }
+    }
+
+    // Advance every chain `rows` steps, storing one row of
+    // CHAOS_MAX_LANES points per step at out
+    void advanceRows(float* out, long long rows) {
+        while (rows > 0) {
+            if (nextChoice == choices.size()) {
+                picker.fill(rng, choices.data(), choices.size());
+                nextChoice = 0;
+            }
+            long long steps = std::min<long long>(rows, (choices.size() - nextChoice) / CHAOS_MAX_LANES);
+            advance(out, steps);
+            nextChoice += steps * CHAOS_MAX_LANES;
+            out += Dims * steps * CHAOS_MAX_LANES;
+            rows -= steps;
+        }
+    }
+
+    // Run the kernel over all chains, one group of `lanes` at a time,
+    // for `steps` rows of choices from nextChoice
+    void advance(float* out, long long steps) {
+        const uint8_t* rows = choices.data() + nextChoice;
+        for (int g = 0; g < CHAOS_MAX_LANES; g += lanes) {
+            kernel(tables, lanePoints + g, rows + g, out + Dims * g,
+                   steps, CHAOS_MAX_LANES);
+        }
+    }
+};
+
+/*
+ * A system's chaos game on N independent chains in parallel
+ */
+template <typename Rng, int Dims>
+class ParallelIfs : public ParallelChains<IfsChain<Rng, Dims> > {
+public:
+    /*
+     * system: maps and weights; system.dimensions must be Dims
+     * seed, threads, burnIn, kernel: as ParallelChaosGame
+     */
+    ParallelIfs(const IfsSystem& system, uint64_t seed, int threads, long long burnIn,
+                ChaosKernelKind kernel = KERNEL_AUTO) {
+        if (threads < 1) threads = 1;
+        Rng rng(seed);
+        for (int t = 0; t < threads; t++) {
+            this->chains.push_back(IfsChain<Rng, Dims>(rng, system, kernel));
+            this->chains.back().discard(burnIn);
+            rng.jump();
+        }
+    }
+};
+
+/*
+ * Bounding box of a system's attractor, from a short single-chain run:
+ * lower and upper corners (dimensions floats each)
+ */
+template <int Dims>
+inline void sampleIfsBounds(const IfsSystem& system, float* lower, float* upper) {
+    const long long SAMPLES = 1 << 16;
+    ParallelIfs<Xoshiro256, Dims> game(system, 0, 1, 64, KERNEL_SCALAR);
+    std::vector<float> points(Dims * SAMPLES);
+    game.generate(points.data(), SAMPLES);
+    for (int d = 0; d < Dims; d++) {
+        lower[d] = upper[d] = points[d];
+    }
+    for (long long i = 1; i < SAMPLES; i++) {
+        for (int d = 0; d < Dims; d++) {
+            lower[d] = std::min(lower[d], points[Dims * i + d]);
+            upper[d] = std::max(upper[d], points[Dims * i + d]);
+        }
+    }
+}
+
+inline void ifsBounds(const IfsSystem& system, float* lower, float* upper) {
+    if (system.dimensions == 3) {
+        sampleIfsBounds<3>(system, lower, upper);
+    } else {
+        sampleIfsBounds<2>(system, lower, upper);
+    }
+}
+
+#endif // IFS_ENGINE_H
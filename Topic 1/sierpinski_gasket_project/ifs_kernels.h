@@ -0,0 +1,250 @@
+/*
+ * ifs_kernels.h - SIMD kernels for general iterated function systems
+ *
+ * The chaos game of chaos_kernels.h moves halfway to one of three
+ * vertices. An iterated function system (IFS) applies one of up to
+ * IFS_MAX_MAPS affine maps instead, each with its own linear part M
+ * and offset t, in 2D or 3D:
+ *
+ *   p' = M[choice] * p + t[choice]
+ *
+ * The kernels advance W independent chains ("lanes") at once in
+ * structure-of-arrays form, as in chaos_kernels.h, and store the W new
+ * points interleaved in lane order, in rows of `stride` lanes per step
+ * (see chaos_kernels.h). Every coefficient of every map is
+ * kept in its own table padded to IFS_MAX_MAPS entries, so a lane's
+ * coefficients are fetched with one register permute per coefficient:
+ * AVX2 permutes 8 entries (up to 8 maps), AVX-512 16. Systems with
+ * more maps than the widest kernel's table run on the scalar kernel.
+ *
+ * Each row is summed in the same order in every kernel (column 0
+ * first, offset last) with separate multiplies and adds, so all
+ * kernels produce bit-identical points. That needs -ffp-contract=off
+ * (see the Makefile): the AVX-512 target includes FMA, and GCC would
+ * otherwise fuse the multiply-adds there.
+ */
+
+#ifndef IFS_KERNELS_H
+#define IFS_KERNELS_H
+
+#include <cstdint>
+#include "chaos_kernels.h"
+
+// Most maps a system may have (choices are drawn as uint8_t)
+const int IFS_MAX_MAPS = 16;
+
+/*
+ * The maps of a Dims-dimensional system, one table per coefficient:
+ * M row by row (Dims * Dims tables), then t (Dims tables). Unused
+ * entries are zero.
+ */
+template <int Dims>
+struct IfsTables {
+    static const int COEFFICIENTS = Dims * (Dims + 1);
+
+    float coefficient[COEFFICIENTS][IFS_MAX_MAPS];
+};
+
+/*
+ * Apply map `map` of tables to in, writing out
+ */
+template <int Dims>
+inline void applyIfsMap(const IfsTables<Dims>& tables, int map, const float* in, float* out) {
+    for (int r = 0; r < Dims; r++) {
+        float sum = tables.coefficient[r * Dims][map] * in[0];
+        for (int c = 1; c < Dims; c++) {
+            sum = sum + tables.coefficient[r * Dims + c][map] * in[c];
+        }
+        out[r] = sum + tables.coefficient[Dims * Dims + r][map];
+    }
+}
+
+/*
+ * Kernel signature
+ *
+ * tables:  the system's maps
+ * lanes:   current point of each lane, Dims rows of CHAOS_MAX_LANES
+ *          (read and updated)
+ * choices: steps rows of `stride` map indices; the kernel reads the
+ *          first W of each row
+ * out:     steps rows of `stride` interleaved points; the kernel
+ *          writes the first W of each row
+ */
+template <int Dims>
+struct IfsKernel {
+    typedef void (*Function)(const IfsTables<Dims>& tables, float* lanes,
+                             const uint8_t* choices, float* out, long long steps,
+                             long long stride);
+};
+
+/*
+ * Scalar kernel - one lane
+ */
+template <int Dims>
+inline void ifsKernelScalar(const IfsTables<Dims>& tables, float* lanes,
+                            const uint8_t* choices, float* out, long long steps,
+                            long long stride) {
+    float point[Dims];
+    for (int d = 0; d < Dims; d++) {
+        point[d] = lanes[d * CHAOS_MAX_LANES];
+    }
+    for (long long i = 0; i < steps; i++) {
+        float* o = out + Dims * stride * i;
+        applyIfsMap<Dims>(tables, choices[stride * i], point, o);
+        for (int d = 0; d < Dims; d++) {
+            point[d] = o[d];
+        }
+    }
+    for (int d = 0; d < Dims; d++) {
+        lanes[d * CHAOS_MAX_LANES] = point[d];
+    }
+}
+
+#ifdef CHAOS_KERNELS_X86
+
+/*
+ * AVX2 kernel - 8 lanes, coefficients selected by a permute of each
+ * table (up to 8 maps)
+ */
+template <int Dims>
+__attribute__((target("avx2")))
+inline void ifsKernelAvx2(const IfsTables<Dims>& tables, float* lanes,
+                          const uint8_t* choices, float* out, long long steps,
+                          long long stride) {
+    const int K = IfsTables<Dims>::COEFFICIENTS;
+    __m256 table[K];
+    for (int k = 0; k < K; k++) {
+        table[k] = _mm256_loadu_ps(tables.coefficient[k]);
+    }
+    __m256 point[Dims];
+    for (int d = 0; d < Dims; d++) {
+        point[d] = _mm256_loadu_ps(lanes + d * CHAOS_MAX_LANES);
+    }
+    for (long long i = 0; i < steps; i++) {
+        __m256i c = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+            reinterpret_cast<const __m128i*>(choices + stride * i)));
+        __m256 next[Dims];
+        for (int r = 0; r < Dims; r++) {
+            __m256 sum = _mm256_mul_ps(_mm256_permutevar8x32_ps(table[r * Dims], c), point[0]);
+            for (int col = 1; col < Dims; col++) {
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(
+                    _mm256_permutevar8x32_ps(table[r * Dims + col], c), point[col]));
+            }
+            next[r] = _mm256_add_ps(sum, _mm256_permutevar8x32_ps(table[Dims * Dims + r], c));
+        }
+        // Interleave through the stack: x0 y0 (z0) x1 y1 (z1) ...
+        float rows[Dims][8];
+        for (int d = 0; d < Dims; d++) {
+            point[d] = next[d];
+            _mm256_storeu_ps(rows[d], next[d]);
+        }
+        float* o = out + Dims * stride * i;
+        for (int l = 0; l < 8; l++) {
+            for (int d = 0; d < Dims; d++) {
+                o[Dims * l + d] = rows[d][l];
+            }
+        }
+    }
+    for (int d = 0; d < Dims; d++) {
+        _mm256_storeu_ps(lanes + d * CHAOS_MAX_LANES, point[d]);
+    }
+}
+
+/*
+ * AVX-512 kernel - 16 lanes, coefficients selected by a permute of
+ * each table (up to 16 maps)
+ */
+template <int Dims>
+__attribute__((target("avx512f")))
+inline void ifsKernelAvx512(const IfsTables<Dims>& tables, float* lanes,
+                            const uint8_t* choices, float* out, long long steps,
+                            long long stride) {
+    const int K = IfsTables<Dims>::COEFFICIENTS;
+    const __mmask16 all = 0xFFFF;
+    __m512 table[K];
+    for (int k = 0; k < K; k++) {
+        table[k] = _mm512_loadu_ps(tables.coefficient[k]);
+    }
+    __m512 point[Dims];
+    for (int d = 0; d < Dims; d++) {
+        point[d] = _mm512_loadu_ps(lanes + d * CHAOS_MAX_LANES);
+    }
+    for (long long i = 0; i < steps; i++) {
+        // Zero-masked forms with a full mask, as in chaos_kernels.h
+        __m512i c = _mm512_maskz_cvtepu8_epi32(all, _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(choices + stride * i)));
+        __m512 next[Dims];
+        for (int r = 0; r < Dims; r++) {
+            __m512 sum = _mm512_mul_ps(_mm512_maskz_permutexvar_ps(all, c, table[r * Dims]),
+                                       point[0]);
+            for (int col = 1; col < Dims; col++) {
+                sum = _mm512_add_ps(sum, _mm512_mul_ps(
+                    _mm512_maskz_permutexvar_ps(all, c, table[r * Dims + col]), point[col]));
+            }
+            next[r] = _mm512_add_ps(sum, _mm512_maskz_permutexvar_ps(all, c, table[Dims * Dims + r]));
+        }
+        float rows[Dims][16];
+        for (int d = 0; d < Dims; d++) {
+            point[d] = next[d];
+            _mm512_storeu_ps(rows[d], next[d]);
+        }
+        float* o = out + Dims * stride * i;
+        for (int l = 0; l < 16; l++) {
+            for (int d = 0; d < Dims; d++) {
+                o[Dims * l + d] = rows[d][l];
+            }
+        }
+    }
+    for (int d = 0; d < Dims; d++) {
+        _mm512_storeu_ps(lanes + d * CHAOS_MAX_LANES, point[d]);
+    }
+}
+
+#endif // CHAOS_KERNELS_X86
+
+/*
+ * Can the given kernel run a system of `maps` maps on this CPU? SSE2
+ * has no register permute, so it has no IFS kernel.
+ */
+inline bool ifsKernelSupported(ChaosKernelKind kind, int maps) {
+    switch (kind) {
+        case KERNEL_AUTO:
+        case KERNEL_SCALAR:
+            return true;
+        case KERNEL_AVX2:
+            return maps <= 8 && chaosKernelSupported(kind);
+        case KERNEL_AVX512:
+            return maps <= 16 && chaosKernelSupported(kind);
+        default:
+            return false;
+    }
+}
+
+/*
+ * Resolve KERNEL_AUTO to the widest kernel that can run `maps` maps
+ */
+inline ChaosKernelKind resolveIfsKernel(ChaosKernelKind kind, int maps) {
+    if (kind != KERNEL_AUTO) {
+        return kind;
+    }
+    const ChaosKernelKind preferred[] = {KERNEL_AVX512, KERNEL_AVX2};
+    for (ChaosKernelKind k : preferred) {
+        if (ifsKernelSupported(k, maps)) {
+            return k;
+        }
+    }
+    return KERNEL_SCALAR;
+}
+
+template <int Dims>
+inline typename IfsKernel<Dims>::Function ifsKernelFunction(ChaosKernelKind kind) {
+    switch (kind) {
+#ifdef CHAOS_KERNELS_X86
+        case KERNEL_AVX2:   return ifsKernelAvx2<Dims>;
+        case KERNEL_AVX512: return ifsKernelAvx512<Dims>;
+#endif
+        default:            return ifsKernelScalar<Dims>;
+    }
+}
+
+#endif // IFS_KERNELS_H
@@ -0,0 +1,317 @@
+/*
+ * indexed_gasket.h - Shared-vertex (indexed) gasket meshes
+ *
+ * A plain gasket mesh stores the corners of every leaf triangle
+ * separately, although neighbouring leaves meet at their corners. An
+ * IndexedGasket stores every distinct point once plus three indices
+ * per triangle, to be drawn with glDrawElements().
+ *
+ * No lookup is needed to find shared points. Triangles (tetrahedra)
+ * of one level touch only at corners, never along an edge, so every
+ * edge midpoint is created by exactly one node of the subdivision.
+ * Numbering the midpoints level by level gives each a fixed index:
+ *
+ *   midpoint e of node `path` at level k  ->  V(k) + E * path + e
+ *
+ * where V(k) is the number of points of the level-k gasket
+ * (sharedVertices in gasket_geometry.h), E the number of edges per
+ * node (3 in 2D, 6 in 3D) and path the node's position in traversal
+ * order; the root's corners are 0 to 2 (0 to 3 in 3D). Each index
+ * therefore depends only on where a point is, so subtrees can be built
+ * on several threads and the mesh is identical for any thread count.
+ * Triangles come out in the same order, and points with the same
+ * float values, as generateGasket2D() / subdivideTetrahedron().
+ *
+ * Indices are 16-bit while every point fits (up to depth 9 in 2D and
+ * depth 7 in 3D) and 32-bit beyond that.
+ */
+
+#ifndef INDEXED_GASKET_H
+#define INDEXED_GASKET_H
+
+#include <cstdint>
+#include <vector>
+#include "gasket_geometry.h"
+
+// Most points 16-bit indices can address
+const uint64_t INDEX16_MAX_VERTICES = 65536;
+
+// Floats per point of a 3D mesh: x, y, z
+const int FLOATS_PER_POINT_3D = 3;
+
+struct IndexedGasket {
+    std::vector<float> vertices;        // x, y (2D) or x, y, z (3D) per point
+    std::vector<uint16_t> indices16;    // triangles, when all points fit in 16 bits
+    std::vector<uint32_t> indices32;    // triangles otherwise
+
+    bool wide() const {
+        return !indices32.empty();
+    }
+
+    size_t indexCount() const {
+        return wide() ? indices32.size() : indices16.size();
+    }
+
+    uint32_t index(size_t i) const {
+        return wide() ? indices32[i] : indices16[i];
+    }
+
+    size_t bytes() const {
+        return vertices.size() * sizeof(float) + indices16.size() * sizeof(uint16_t)
+               + indices32.size() * sizeof(uint32_t);
+    }
+
+    // Release everything
+    void clear() {
+        std::vector<float>().swap(vertices);
+        std::vector<uint16_t>().swap(indices16);
+        std::vector<uint32_t>().swap(indices32);
+    }
+};
+
+constexpr uint64_t saturatingAdd(uint64_t a, uint64_t b) {
+    return b > UINT64_MAX - a ? UINT64_MAX : a + b;
+}
+
+constexpr uint64_t gasketIndexBytes(uint64_t vertices) {
+    return vertices <= INDEX16_MAX_VERTICES ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+/*
+ * Bytes of a depth-`depth` indexed mesh (points and indices), or
+ * UINT64_MAX if the depth is beyond the table
+ */
+constexpr uint64_t gasketIndexedBytes(bool threeD, int depth) {
+    if (depth < 0 || depth > (threeD ? TETRAHEDRON_MAX_LEVELS : SUBDIVISION_MAX_LEVELS)) {
+        return UINT64_MAX;
+    }
+    const GasketLevel level = threeD ? GASKET_3D_LEVELS[depth] : GASKET_2D_LEVELS[depth];
+    uint64_t pointBytes = (threeD ? FLOATS_PER_POINT_3D : FLOATS_PER_POINT_2D) * sizeof(float);
+    return saturatingAdd(saturatingMultiply(level.sharedVertices, pointBytes),
+                         saturatingMultiply(saturatingMultiply(level.triangles, 3),
+                                            gasketIndexBytes(level.sharedVertices)));
+}
+
+static_assert(gasketIndexedBytes(false, 2) == 15 * 8 + 27 * 2, "2D indexed size is wrong");
+static_assert(gasketIndexedBytes(true, 8) == 131074ull * 12 + 4 * 65536 * 3 * 4,
+              "3D indexed size is wrong");
+
+/*
+ * A triangle (3 corners, 2D) or tetrahedron (4 corners, 3D) of the
+ * subdivision: its corners and their indices
+ */
+template <typename Index, int Corners, int Dimensions>
+struct IndexedNode {
+    float corners[Corners][Dimensions];
+    Index ids[Corners];
+};
+
+/*
+ * Subdivide triangle t (node `path` of level `level`) down to level
+ * `stop`: write the midpoints of every node above `stop` into
+ * vertices, and call visit(node, path) for each node at `stop`
+ */
+template <typename Index, typename Visit>
+inline void walkIndexed(const IndexedNode<Index, 3, 2>& t, int level, uint64_t path, int stop,
+                        float* vertices, Visit& visit) {
+    if (level == stop) {
+        visit(t, path);
+        return;
+    }
+    // Points 0-2 are t's corners a, b, c, 3-5 the midpoints ab, bc, ca
+    static const int EDGES[3][2] = {{0, 1}, {1, 2}, {2, 0}};
+    float points[6][2];
+    Index ids[6];
+    uint64_t first = GASKET_2D_LEVELS[level].sharedVertices + 3 * path;
+    for (int v = 0; v < 3; v++) {
+        points[v][0] = t.corners[v][0];
+        points[v][1] = t.corners[v][1];
+        ids[v] = t.ids[v];
+    }
+    for (int e = 0; e < 3; e++) {
+        const float* p = t.corners[EDGES[e][0]];
+        const float* q = t.corners[EDGES[e][1]];
+        points[3 + e][0] = (p[0] + q[0]) / 2.0f;
+        points[3 + e][1] = (p[1] + q[1]) / 2.0f;
+        ids[3 + e] = static_cast<Index>(first + e);
+        vertices[ids[3 + e] * 2] = points[3 + e][0];
+        vertices[ids[3 + e] * 2 + 1] = points[3 + e][1];
+    }
+
+    // Children in the order of subdivideTriangle()
+    static const int CHILDREN[3][3] = {
+        {0, 3, 5},  // Bottom-left: a, ab, ca
+        {3, 1, 4},  // Bottom-right: ab, b, bc
+        {5, 4, 2}   // Top: ca, bc, c
+    };
+    for (int child = 0; child < 3; child++) {
+        IndexedNode<Index, 3, 2> node;
+        for (int v = 0; v < 3; v++) {
+            int point = CHILDREN[child][v];
+            node.corners[v][0] = points[point][0];
+            node.corners[v][1] = points[point][1];
+            node.ids[v] = ids[point];
+        }
+        walkIndexed(node, level + 1, path * 3 + child, stop, vertices, visit);
+    }
+}
+
+/*
+ * Subdivide tetrahedron t down to level `stop`, as for triangles
+ */
+template <typename Index, typename Visit>
+inline void walkIndexed(const IndexedNode<Index, 4, 3>& t, int level, uint64_t path, int stop,
+                        float* vertices, Visit& visit) {
+    if (level == stop) {
+        visit(t, path);
+        return;
+    }
+    // Points 0-3 are t's corners a, b, c, d, 4-9 the midpoints of the
+    // edges ab, ac, ad, bc, bd, cd
+    static const int EDGES[6][2] = {{0, 1}, {0, 2}, {0, 3}, {1, 2}, {1, 3}, {2, 3}};
+    float points[10][3];
+    Index ids[10];
+    uint64_t first = GASKET_3D_LEVELS[level].sharedVertices + 6 * path;
+    for (int v = 0; v < 4; v++) {
+        for (int i = 0; i < 3; i++) {
+            points[v][i] = t.corners[v][i];
+        }
+        ids[v] = t.ids[v];
+    }
+    for (int e = 0; e < 6; e++) {
+        const float* p = t.corners[EDGES[e][0]];
+        const float* q = t.corners[EDGES[e][1]];
+        ids[4 + e] = static_cast<Index>(first + e);
+        for (int i = 0; i < 3; i++) {
+            points[4 + e][i] = (p[i] + q[i]) / 2.0f;
+            vertices[ids[4 + e] * 3 + i] = points[4 + e][i];
+        }
+    }
+
+    // Children in the order of subdivideTetrahedron()
+    static const int CHILDREN[4][4] = {
+        {0, 4, 5, 6},   // Top: a, ab, ac, ad
+        {4, 1, 7, 8},   // Front: ab, b, bc, bd
+        {5, 7, 2, 9},   // Left: ac, bc, c, cd
+        {6, 8, 9, 3}    // Right: ad, bd, cd, d
+    };
+    for (int child = 0; child < 4; child++) {
+        IndexedNode<Index, 4, 3> node;
+        for (int v = 0; v < 4; v++) {
+            int point = CHILDREN[child][v];
+            for (int i = 0; i < 3; i++) {
+                node.corners[v][i] = points[point][i];
+            }
+            node.ids[v] = ids[point];
+        }
+        walkIndexed(node, level + 1, path * 4 + child, stop, vertices, visit);
+    }
+}
+
+/*
+ * Fill vertices and indices for a depth-`depth` gasket, calling
+ * leaf(node, path) for every leaf. The levels above the split are
+ * walked on this thread, collecting the nodes the threads start from;
+ * each thread then walks its own subtrees.
+ */
+template <typename Index, int Corners, int Dimensions, typename Leaf>
+inline void fillIndexedGasket(const IndexedNode<Index, Corners, Dimensions>& root, int depth,
+                              float* vertices, int threads, Leaf leaf) {
+    for (int v = 0; v < Corners; v++) {
+        for (int i = 0; i < Dimensions; i++) {
+            vertices[v * Dimensions + i] = root.corners[v][i];
+        }
+    }
+    int split = subdivisionSplitDepth(depth, Corners, threads);
+    uint64_t tasks = 1;
+    for (int level = 0; level < split; level++) {
+        tasks *= Corners;
+    }
+    std::vector<IndexedNode<Index, Corners, Dimensions>> nodes(tasks);
+    auto collect = [&nodes](const IndexedNode<Index, Corners, Dimensions>& node, uint64_t path) {
+        nodes[path] = node;
+    };
+    walkIndexed(root, 0, 0, split, vertices, collect);
+    runSubdivisionTasks(tasks, threads, [&](uint64_t task) {
+        Leaf visit = leaf;
+        walkIndexed(nodes[task], split, task, depth, vertices, visit);
+    });
+}
+
+template <typename Index>
+inline void fillIndexedGasket2D(const float a[2], const float b[2], const float c[2], int depth,
+                                float* vertices, Index* indices, int threads) {
+    IndexedNode<Index, 3, 2> root = {{{a[0], a[1]}, {b[0], b[1]}, {c[0], c[1]}}, {0, 1, 2}};
+    auto leaf = [indices](const IndexedNode<Index, 3, 2>& node, uint64_t path) {
+        for (int v = 0; v < 3; v++) {
+            indices[path * 3 + v] = node.ids[v];
+        }
+    };
+    fillIndexedGasket(root, depth, vertices, threads, leaf);
+}
+
+/*
+ * faces: the corners of each face, in the order the faces are drawn.
+ * Indices are sorted by face into NUM_FACES equal sections, like the
+ * 3D program's plain mesh.
+ */
+template <typename Index>
+inline void fillIndexedGasket3D(const float corners[4][3], const int faces[4][3], int depth,
+                                float* vertices, Index* indices, int threads) {
+    IndexedNode<Index, 4, 3> root;
+    for (int v = 0; v < 4; v++) {
+        for (int i = 0; i < 3; i++) {
+            root.corners[v][i] = corners[v][i];
+        }
+        root.ids[v] = static_cast<Index>(v);
+    }
+    uint64_t section = 3 * GASKET_3D_LEVELS[depth].leaves;
+    auto leaf = [indices, faces, section](const IndexedNode<Index, 4, 3>& node, uint64_t path) {
+        for (int f = 0; f < 4; f++) {
+            for (int v = 0; v < 3; v++) {
+                indices[f * section + path * 3 + v] = node.ids[faces[f][v]];
+            }
+        }
+    };
+    fillIndexedGasket(root, depth, vertices, threads, leaf);
+}
+
+/*
+ * Generate the depth-`depth` indexed 2D gasket of triangle (a, b, c)
+ * into mesh, sized exactly once from the size table
+ */
+inline void generateIndexedGasket2D(const float a[2], const float b[2], const float c[2],
+                                    int depth, IndexedGasket& mesh, int threads = 1) {
+    const GasketLevel& level = GASKET_2D_LEVELS[depth];
+    mesh.clear();
+    allocateMesh(mesh.vertices, level.sharedVertices * FLOATS_PER_POINT_2D);
+    if (level.sharedVertices <= INDEX16_MAX_VERTICES) {
+        allocateMesh(mesh.indices16, level.triangles * 3);
+        fillIndexedGasket2D(a, b, c, depth, mesh.vertices.data(), mesh.indices16.data(), threads);
+    } else {
+        allocateMesh(mesh.indices32, level.triangles * 3);
+        fillIndexedGasket2D(a, b, c, depth, mesh.vertices.data(), mesh.indices32.data(), threads);
+    }
+}
+
+/*
+ * Generate the depth-`depth` indexed 3D gasket of the tetrahedron
+ * `corners` into mesh, faces sorted into sections as above
+ */
+inline void generateIndexedGasket3D(const float corners[4][3], const int faces[4][3], int depth,
+                                    IndexedGasket& mesh, int threads = 1) {
+    const GasketLevel& level = GASKET_3D_LEVELS[depth];
+    mesh.clear();
+    allocateMesh(mesh.vertices, level.sharedVertices * FLOATS_PER_POINT_3D);
+    if (level.sharedVertices <= INDEX16_MAX_VERTICES) {
+        allocateMesh(mesh.indices16, level.triangles * 3);
+        fillIndexedGasket3D(corners, faces, depth, mesh.vertices.data(), mesh.indices16.data(),
+                            threads);
+    } else {
+        allocateMesh(mesh.indices32, level.triangles * 3);
+        fillIndexedGasket3D(corners, faces, depth, mesh.vertices.data(), mesh.indices32.data(),
+                            threads);
+    }
+}
+
+#endif // INDEXED_GASKET_H
@@ -0,0 +1,203 @@
+/*
+ * instanced_mesh.h - Instanced drawing of scaled, translated copies
+ *
+ * Every leaf of a subdivided gasket is the same base shape, only
+ * scaled and moved. Instead of storing the vertices of every leaf, an
+ * InstancedMesh stores the base shape once plus one offset and scale
+ * (4 floats) per leaf, and draws all leaves with a single
+ * glDrawArraysInstanced():
+ *
+ *   vertex = offset + scale * baseVertex
+ *
+ * Base vertices are interleaved floats with the position (3) first
+ * and the color (3) next; any further floats (e.g. a normal) are
+ * skipped. A small vertex shader applies the per-instance transform
+ * and the fixed-function modelview/projection matrices, so the caller
+ * positions the mesh with glRotatef etc. as usual.
+ *
+ * Instanced arrays need OpenGL 3.3; supported() reports whether they
+ * are available. The legacy contexts GLUT creates on macOS stop at
+ * OpenGL 2.1, so this is compiled out there.
+ */
+
+#ifndef INSTANCED_MESH_H
+#define INSTANCED_MESH_H
+
+#ifdef __APPLE__
+    #include <GLUT/glut.h>
+#else
+    #ifndef GL_GLEXT_PROTOTYPES
+        #define GL_GLEXT_PROTOTYPES
+    #endif
+    #include <GL/glut.h>
+#endif
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+// Floats per instance: x, y, z offset and scale
+const int FLOATS_PER_INSTANCE = 4;
+
+class InstancedMesh {
+public:
+    // floatsPerVertex: stride of the base vertices (at least 6)
+    explicit InstancedMesh(int floatsPerVertex)
+        : program(0), programFailed(false), baseVbo(0), instanceVbo(0), baseCount(0),
+          instanceCount(0), floatsPerVertex(floatsPerVertex) {}
+
+    /*
+     * Does the current context support instanced arrays (GL 3.3+)?
+     * Requires a current GL context.
+     */
+    static bool supported() {
+#ifdef __APPLE__
+        return false;
+#else
+        const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+        int major = 0, minor = 0;
+        if (version == NULL || std::sscanf(version, "%d.%d", &major, &minor) != 2) {
+            return false;
+        }
+        return major > 3 || (major == 3 && minor >= 3);
+#endif
+    }
+
+    // Number of instances currently stored
+    GLsizei size() const {
+        return instanceCount;
+    }
+
+    // Replace the base shape (floatsPerVertex floats per vertex)
+    void setBase(const std::vector<float>& vertices) {
+#ifndef __APPLE__
+        upload(baseVbo, vertices);
+        baseCount = static_cast<GLsizei>(vertices.size() / floatsPerVertex);
+#endif
+    }
+
+    // Replace the instances (FLOATS_PER_INSTANCE floats each)
+    void setInstances(const std::vector<float>& instances) {
+#ifndef __APPLE__
+        upload(instanceVbo, instances);
+        instanceCount = static_cast<GLsizei>(instances.size() / FLOATS_PER_INSTANCE);
+#endif
+    }
+
+    // Draw every instance of the base shape with one call
+    void draw(GLenum mode) {
+#ifndef __APPLE__
+        if (baseCount == 0 || instanceCount == 0 || !buildProgram()) {
+            return;
+        }
+        GLsizei stride = floatsPerVertex * sizeof(float);
+        glUseProgram(program);
+        glBindBuffer(GL_ARRAY_BUFFER, baseVbo);
+        glEnableVertexAttribArray(POSITION);
+        glVertexAttribPointer(POSITION, 3, GL_FLOAT, GL_FALSE, stride, NULL);
+        glEnableVertexAttribArray(COLOR);
+        glVertexAttribPointer(COLOR, 3, GL_FLOAT, GL_FALSE, stride,
+                              reinterpret_cast<const void*>(3 * sizeof(float)));
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+        glEnableVertexAttribArray(INSTANCE);
+        glVertexAttribPointer(INSTANCE, FLOATS_PER_INSTANCE, GL_FLOAT, GL_FALSE, 0, NULL);
+        glVertexAttribDivisor(INSTANCE, 1);  // advance once per instance
+
+        glDrawArraysInstanced(mode, 0, baseCount, instanceCount);
+
+        glVertexAttribDivisor(INSTANCE, 0);
+        glDisableVertexAttribArray(POSITION);
+        glDisableVertexAttribArray(COLOR);
+        glDisableVertexAttribArray(INSTANCE);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glUseProgram(0);
+#endif
+    }
+
+private:
+    // Attribute locations used by the shader
+    enum { POSITION = 0, COLOR = 1, INSTANCE = 2 };
+
+    GLuint program;
+    bool programFailed;     // don't retry (and re-print the log) every frame
+    GLuint baseVbo;
+    GLuint instanceVbo;
+    GLsizei baseCount;
+    GLsizei instanceCount;
+    int floatsPerVertex;
+
+#ifndef __APPLE__
+    void upload(GLuint& vbo, const std::vector<float>& data) {
+        if (vbo == 0) {
+            glGenBuffers(1, &vbo);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), data.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    /*
+     * Compile and link the shader on first use. Returns false (after
+     * printing the log) if that failed.
+     */
+    bool buildProgram() {
+        if (program != 0 || programFailed) {
+            return !programFailed;
+        }
+        static const char* vertexSource =
+            "#version 330 compatibility\n"
+            "layout(location = 0) in vec3 position;\n"
+            "layout(location = 1) in vec3 color;\n"
+            "layout(location = 2) in vec4 instance;  // xyz offset, w scale\n"
+            "out vec3 vertexColor;\n"
+            "void main() {\n"
+            "    vertexColor = color;\n"
+            "    vec3 world = instance.xyz + instance.w * position;\n"
+            "    gl_Position = gl_ModelViewProjectionMatrix * vec4(world, 1.0);\n"
+            "}\n";
+        static const char* fragmentSource =
+            "#version 330 compatibility\n"
+            "in vec3 vertexColor;\n"
+            "out vec4 fragColor;\n"
+            "void main() {\n"
+            "    fragColor = vec4(vertexColor, 1.0);\n"
+            "}\n";
+        GLuint vertex = compile(GL_VERTEX_SHADER, vertexSource);
+        GLuint fragment = compile(GL_FRAGMENT_SHADER, fragmentSource);
+        GLuint linked = glCreateProgram();
+        glAttachShader(linked, vertex);
+        glAttachShader(linked, fragment);
+        glLinkProgram(linked);
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+
+        GLint success;
+        glGetProgramiv(linked, GL_LINK_STATUS, &success);
+        if (!success) {
+            GLchar infoLog[512];
+            glGetProgramInfoLog(linked, 512, NULL, infoLog);
+            std::cerr << "Instancing shader failed to link:\n" << infoLog << std::endl;
+            glDeleteProgram(linked);
+            programFailed = true;
+            return false;
+        }
+        program = linked;
+        return true;
+    }
+
+    static GLuint compile(GLenum type, const char* source) {
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        GLint success;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            GLchar infoLog[512];
+            glGetShaderInfoLog(shader, 512, NULL, infoLog);
+            std::cerr << "Instancing shader failed to compile:\n" << infoLog << std::endl;
+        }
+        return shader;
+    }
+#endif
+};
+
+#endif // INSTANCED_MESH_H
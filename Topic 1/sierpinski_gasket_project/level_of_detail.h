@@ -0,0 +1,307 @@
+/*
+ * level_of_detail.h - View-dependent level of detail for the 3D gasket
+ *
+ * Instead of one global depth, each tetrahedron is subdivided only
+ * while it covers more than a given number of pixels on screen, and
+ * tetrahedra outside the view are dropped. Zooming in then refines
+ * only the visible part, so the triangle count stays about the same at
+ * any magnification.
+ *
+ * Deep zooms need more than float precision. The view zooms in on a
+ * focus point kept as the sum of two doubles (ZoomFocus). Tetrahedra
+ * are kept in double relative to that focus (LodTetrahedron), and
+ * generateLodMesh() converts their corners to float only after the
+ * view centre has been subtracted, so the floats hold only what is on
+ * screen, at any zoom.
+ */
+
+#ifndef LEVEL_OF_DETAIL_H
+#define LEVEL_OF_DETAIL_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "tetrahedron_subdivision.h"
+
+/*
+ * Point the view zooms in on, kept as the unevaluated sum hi + lo of
+ * two doubles (about 106 bits), so it can still be moved by a fraction
+ * of a pixel at a zoom of 1e30
+ */
+struct ZoomFocus {
+    double hi[3];
+    double lo[3];
+
+    void set(const double p[3]) {
+        for (int i = 0; i < 3; i++) {
+            hi[i] = p[i];
+            lo[i] = 0.0;
+        }
+    }
+
+    /*
+     * Move by step, keeping hi + lo exact to about 106 bits (Knuth's
+     * two-sum, then renormalised so lo stays below half an ulp of hi)
+     */
+    void move(const double step[3]) {
+        for (int i = 0; i < 3; i++) {
+            double sum = hi[i] + step[i];
+            double bv = sum - hi[i];
+            double error = (hi[i] - (sum - bv)) + (step[i] - bv);
+            double l = lo[i] + error;
+            hi[i] = sum + l;
+            lo[i] = l - (hi[i] - sum);
+        }
+    }
+
+    /*
+     * Model point drawn at the centre of the view. It moves from the
+     * origin (zoom 1) to the focus as the zoom grows, so the focus
+     * stays in the same place on screen.
+     */
+    void viewCenter(double zoom, double center[3]) const {
+        for (int i = 0; i < 3; i++) {
+            center[i] = (hi[i] + lo[i]) * (1.0 - 1.0 / zoom);
+        }
+    }
+
+    /*
+     * viewCenter() - hi, without cancellation: about 1 / zoom, with
+     * full relative precision however deep the zoom
+     */
+    void viewCenterFromFocus(double zoom, double center[3]) const {
+        for (int i = 0; i < 3; i++) {
+            center[i] = lo[i] * (1.0 - 1.0 / zoom) - hi[i] / zoom;
+        }
+    }
+};
+
+// A tetrahedron met while choosing the level of detail. Like every
+// leaf it is the original scaled and moved: its corners are
+// focus.hi + offset + size * corners[k]. Kept relative to the focus in
+// double, the offset of a tetrahedron near the focus is about as small
+// as the tetrahedron itself, so it keeps full relative precision at
+// any depth where float model coordinates would have collapsed.
+struct LodTetrahedron {
+    double offset[3];
+    double size;
+    int depth;
+};
+
+/*
+ * The camera on the CPU: model point p is at
+ *
+ *   R * (scale * (p - focus.hi - center)) - (0, 0, eyeDistance)
+ *
+ * in eye coordinates, with R the three glRotatef() calls
+ */
+struct LodView {
+    double rotation[3][3];
+    double scale;
+    double center[3];       // view centre relative to focus.hi
+    double tanX, tanY;      // half field of view, horizontal and vertical
+    double height;          // viewport height in pixels
+    double eyeDistance;
+    double nearPlane, farPlane;
+};
+
+/*
+ * Rotation matrix of glRotatef(degrees) about axis (0 = x, 1 = y, 2 = z)
+ */
+inline void axisRotation(int axis, float degrees, double out[3][3]) {
+    double radians = degrees * M_PI / 180.0;
+    double c = std::cos(radians);
+    double s = std::sin(radians);
+    int u = (axis + 1) % 3;
+    int v = (axis + 2) % 3;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            out[i][j] = i == j ? 1.0 : 0.0;
+        }
+    }
+    out[u][u] = c;
+    out[u][v] = -s;
+    out[v][u] = s;
+    out[v][v] = c;
+}
+
+/*
+ * Rotation of glRotatef(x) glRotatef(y) glRotatef(z), about the x, y
+ * and z axes in that order
+ */
+inline void viewRotation(float x, float y, float z, double out[3][3]) {
+    double rx[3][3], ry[3][3], rz[3][3], rxy[3][3];
+    axisRotation(0, x, rx);
+    axisRotation(1, y, ry);
+    axisRotation(2, z, rz);
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            rxy[i][j] = rx[i][0] * ry[0][j] + rx[i][1] * ry[1][j] + rx[i][2] * ry[2][j];
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            out[i][j] = rxy[i][0] * rz[0][j] + rxy[i][1] * rz[1][j] + rxy[i][2] * rz[2][j];
+        }
+    }
+}
+
+/*
+ * Centroid of the tetrahedron `corners` and the radius of its bounding
+ * sphere about it
+ */
+inline void vertexBounds(const point3 corners[4], double centroid[3], double& radius) {
+    for (int i = 0; i < 3; i++) {
+        centroid[i] = (corners[0][i] + corners[1][i] + corners[2][i] + corners[3][i]) / 4.0;
+    }
+    radius = 0.0;
+    for (int v = 0; v < 4; v++) {
+        double dx = corners[v][0] - centroid[0];
+        double dy = corners[v][1] - centroid[1];
+        double dz = corners[v][2] - centroid[2];
+        radius = std::max(radius, std::sqrt(dx * dx + dy * dy + dz * dz));
+    }
+}
+
+/*
+ * Position of model point focus.hi + p relative to the view centre,
+ * scaled to eye units but not yet rotated
+ */
+inline double viewOffset(const LodView& view, double p, int axis) {
+    return view.scale * (p - view.center[axis]);
+}
+
+/*
+ * Pixels tetrahedron t spans on screen, from its bounding sphere (the
+ * original's centroid and radius, from vertexBounds()): 0 if it is
+ * entirely outside the view, unbounded once it reaches the near plane
+ */
+inline double projectedPixels(const LodView& view, const double centroid[3], double radius,
+                              const LodTetrahedron& t) {
+    radius *= view.scale * t.size;
+
+    double eye[3];
+    for (int i = 0; i < 3; i++) {
+        eye[i] = 0.0;
+        for (int j = 0; j < 3; j++) {
+            eye[i] += view.rotation[i][j] * viewOffset(view, t.offset[j] + t.size * centroid[j], j);
+        }
+    }
+    double distance = view.eyeDistance - eye[2];   // along the view direction
+
+    // Outside the near, far or one of the four side planes
+    if (distance + radius < view.nearPlane || distance - radius > view.farPlane) {
+        return 0.0;
+    }
+    double sideX = std::sqrt(1.0 + view.tanX * view.tanX);
+    double sideY = std::sqrt(1.0 + view.tanY * view.tanY);
+    if ((std::fabs(eye[0]) - view.tanX * distance) / sideX > radius ||
+        (std::fabs(eye[1]) - view.tanY * distance) / sideY > radius) {
+        return 0.0;
+    }
+    if (distance - radius <= view.nearPlane) {
+        return HUGE_VAL;
+    }
+    return radius * view.height / ((distance - radius) * view.tanY);
+}
+
+// Leaves chosen for one view
+struct LodLeaves {
+    std::vector<LodTetrahedron> leaves;
+    int deepest = 0;        // depth of the smallest leaves
+    bool capped = false;    // refinement stopped at the leaf limit
+};
+
+/*
+ * Choose the leaves of the tetrahedron `corners` for view into out:
+ * starting from the whole tetrahedron (at `offset` from the focus),
+ * one level at a time, drop what is out of view and split what still
+ * spans more than maxPixels, down to at most maxDepth and at most
+ * `limit` leaves. Refining level by level, rather than depth first,
+ * means a mesh that hits the limit is equally coarse everywhere
+ * instead of detailed on one side only.
+ */
+inline void collectLodLeaves(const LodView& view, const point3 corners[4], const double offset[3],
+                             int maxDepth, double maxPixels, uint64_t limit, LodLeaves& out) {
+    double centroid[3], radius;
+    vertexBounds(corners, centroid, radius);
+    std::vector<LodTetrahedron> level(1), split;
+    for (int i = 0; i < 3; i++) {
+        level[0].offset[i] = offset[i];
+    }
+    level[0].size = 1.0;
+    level[0].depth = 0;
+    out.leaves.clear();
+    out.deepest = 0;
+    out.capped = false;
+
+    while (!level.empty()) {
+        split.clear();
+        for (const LodTetrahedron& t : level) {
+            double pixels = projectedPixels(view, centroid, radius, t);
+            if (pixels == 0.0) {
+                continue;
+            }
+            if (t.depth < maxDepth && pixels > maxPixels) {
+                split.push_back(t);
+            } else {
+                out.leaves.push_back(t);
+                out.deepest = std::max(out.deepest, t.depth);
+            }
+        }
+        if (out.leaves.size() + 4 * split.size() > limit) {
+            // One more level would not fit: keep these as they are
+            for (const LodTetrahedron& t : split) {
+                out.leaves.push_back(t);
+                out.deepest = std::max(out.deepest, t.depth);
+            }
+            out.capped = !split.empty();
+            break;
+        }
+        level.clear();
+        for (const LodTetrahedron& t : split) {
+            for (int corner = 0; corner < 4; corner++) {
+                // Corner c of a tetrahedron: half the size, moved half
+                // way to vertex c (exact: sizes are powers of two)
+                LodTetrahedron child;
+                child.size = t.size / 2.0;
+                for (int i = 0; i < 3; i++) {
+                    child.offset[i] = t.offset[i] + child.size * corners[corner][i];
+                }
+                child.depth = t.depth + 1;
+                level.push_back(child);
+            }
+        }
+    }
+}
+
+/*
+ * Write the triangles of leaves into mesh, sorted into face sections
+ * as subdivideTetrahedron() does. The mesh keeps its capacity, as it
+ * is rebuilt whenever the view changes.
+ *
+ * Corners are stored relative to the view centre and already scaled
+ * by the zoom (the caller then only rotates them): the subtraction is
+ * done in double, so the floats hold only what is on screen.
+ */
+inline void generateLodMesh(const LodView& view, const point3 corners[4],
+                            const std::vector<LodTetrahedron>& leaves, std::vector<float>& mesh) {
+    size_t sectionFloats = leaves.size() * 3 * FLOATS_PER_VERTEX;
+    mesh.resize(NUM_FACES * sectionFloats);
+    float* out[NUM_FACES];
+    for (int f = 0; f < NUM_FACES; f++) {
+        out[f] = mesh.data() + f * sectionFloats;
+    }
+    for (const LodTetrahedron& t : leaves) {
+        point3 leaf[4];
+        for (int k = 0; k < 4; k++) {
+            for (int i = 0; i < 3; i++) {
+                leaf[k][i] = static_cast<float>(viewOffset(view, t.offset[i] + t.size * corners[k][i], i));
+            }
+        }
+        subdivideTetrahedron(leaf[0], leaf[1], leaf[2], leaf[3], 0, false, out);
+    }
+}
+
+#endif // LEVEL_OF_DETAIL_H
@@ -0,0 +1,189 @@
+/*
+ * mesh_export.h - Streaming binary STL / PLY output
+ *
+ * A deep gasket does not fit in memory as a mesh: depth 12 of the 3D
+ * gasket is 67 million triangles, 3.3 GB as STL. These helpers only
+ * encode and write; the caller generates the mesh one chunk at a time
+ * and hands each chunk's bytes to streamExportChunks(), which writes
+ * chunk k on a second thread while chunk k + 1 is being filled. Two
+ * chunk buffers are all that is ever held, whatever the mesh size.
+ *
+ * Every triangle takes the same number of bytes, so exportFileBytes()
+ * gives the exact file size before anything is generated. The writers
+ * add up the bytes fwrite() reports, and the caller checks the total
+ * at the end (ftell() would fail on pipes, and is 32-bit on Windows).
+ *
+ * Formats, chosen from the file name:
+ *
+ *   .stl  80-byte header, uint32 triangle count, then per triangle a
+ *         float32 normal, three float32 x, y, z corners and a uint16
+ *         attribute (0): 50 bytes
+ *   .ply  binary PLY with three unshared vertices per triangle (float32
+ *         x, y, z) followed by the faces (uchar 3, three uint32 vertex
+ *         indices): 36 + 13 bytes per triangle
+ *
+ * Values are written in native byte order; the PLY header names it.
+ * STL readers expect little-endian, as on x86-64 and ARM64.
+ */
+
+#ifndef MESH_EXPORT_H
+#define MESH_EXPORT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <string>
+#include <vector>
+
+enum MeshExportFormat {
+    EXPORT_STL,
+    EXPORT_PLY
+};
+
+// Sizes in bytes of each part of the two formats
+const uint64_t STL_HEADER_BYTES = 80 + 4;
+const uint64_t STL_TRIANGLE_BYTES = 12 + 36 + 2;
+const uint64_t PLY_TRIANGLE_VERTEX_BYTES = 36;
+const uint64_t PLY_FACE_BYTES = 1 + 12;
+
+// Most triangles either format can count: STL stores the count, and
+// PLY the vertex indices (three per triangle), as uint32
+const uint64_t EXPORT_MAX_TRIANGLES = UINT32_MAX / 3;
+
+/*
+ * Format from the extension of path (.stl or .ply, either case).
+ * Returns false for anything else.
+ */
+inline bool exportFormatFromPath(const char* path, MeshExportFormat& format) {
+    const char* dot = std::strrchr(path, '.');
+    if (dot == NULL) {
+        return false;
+    }
+    std::string extension(dot + 1);
+    for (char& c : extension) {
+        c = static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    }
+    if (extension == "stl") {
+        format = EXPORT_STL;
+    } else if (extension == "ply") {
+        format = EXPORT_PLY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline const char* exportFormatName(MeshExportFormat format) {
+    return format == EXPORT_STL ? "stl" : "ply";
+}
+
+/*
+ * Text header of a binary PLY file holding `triangles` triangles
+ */
+inline std::string plyHeader(uint64_t triangles) {
+    const uint16_t one = 1;
+    bool littleEndian = *reinterpret_cast<const uint8_t*>(&one) == 1;
+    std::string header = "ply\n";
+    header += littleEndian ? "format binary_little_endian 1.0\n" : "format binary_big_endian 1.0\n";
+    header += "comment Sierpinski gasket\n";
+    header += "element vertex " + std::to_string(3 * triangles) + "\n";
+    header += "property float x\nproperty float y\nproperty float z\n";
+    header += "element face " + std::to_string(triangles) + "\n";
+    header += "property list uchar uint vertex_indices\n";
+    header += "end_header\n";
+    return header;
+}
+
+/*
+ * Exact size of the file for `triangles` triangles
+ */
+inline uint64_t exportFileBytes(MeshExportFormat format, uint64_t triangles) {
+    if (format == EXPORT_STL) {
+        return STL_HEADER_BYTES + triangles * STL_TRIANGLE_BYTES;
+    }
+    return plyHeader(triangles).size() + triangles * (PLY_TRIANGLE_VERTEX_BYTES + PLY_FACE_BYTES);
+}
+
+/*
+ * Write the header of an STL or PLY file, adding the bytes written to
+ * `written`. Returns false if the write fails.
+ */
+inline bool writeExportHeader(FILE* out, MeshExportFormat format, uint64_t triangles,
+                              uint64_t& written) {
+    std::string header;
+    if (format == EXPORT_STL) {
+        header.assign(80, '\0');
+        std::strncpy(&header[0], "Sierpinski gasket, binary STL", 80);
+        uint32_t count = static_cast<uint32_t>(triangles);
+        header.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    } else {
+        header = plyHeader(triangles);
+    }
+    size_t n = std::fwrite(header.data(), 1, header.size(), out);
+    written += n;
+    return n == header.size();
+}
+
+/*
+ * Encode one STL triangle (normal and three x, y, z corners) at out,
+ * returning the end of the record
+ */
+inline char* encodeStlTriangle(const float normal[3], const float corners[9], char* out) {
+    const uint16_t attribute = 0;
+    std::memcpy(out, normal, 12);
+    std::memcpy(out + 12, corners, 36);
+    std::memcpy(out + 48, &attribute, 2);
+    return out + STL_TRIANGLE_BYTES;
+}
+
+/*
+ * Encode the three PLY vertices of a triangle at out
+ */
+inline char* encodePlyVertices(const float corners[9], char* out) {
+    std::memcpy(out, corners, PLY_TRIANGLE_VERTEX_BYTES);
+    return out + PLY_TRIANGLE_VERTEX_BYTES;
+}
+
+/*
+ * Encode PLY face `triangle`, whose vertices are the three written for
+ * it by encodePlyVertices()
+ */
+inline char* encodePlyFace(uint64_t triangle, char* out) {
+    const uint8_t corners = 3;
+    uint32_t first = static_cast<uint32_t>(3 * triangle);
+    uint32_t indices[3] = {first, first + 1, first + 2};
+    out[0] = static_cast<char>(corners);
+    std::memcpy(out + 1, indices, 12);
+    return out + PLY_FACE_BYTES;
+}
+
+/*
+ * Write chunks 0 to count - 1 to out in order, adding the bytes written
+ * to `written`. fill(k, bytes) encodes chunk k into bytes, resizing it
+ * as needed; the buffer of chunk k - 1 is being written meanwhile, so
+ * fill must not touch anything else shared. Returns false if a write
+ * fails.
+ */
+template <typename Fill>
+inline bool streamExportChunks(FILE* out, uint64_t count, Fill fill, uint64_t& written) {
+    std::vector<char> chunks[2];
+    int current = 0;
+    std::future<bool> writer;
+    for (uint64_t k = 0; k < count; k++) {
+        fill(k, chunks[current]);
+        if (writer.valid() && !writer.get()) {
+            return false;
+        }
+        const std::vector<char>& bytes = chunks[current];
+        writer = std::async(std::launch::async, [&bytes, out, &written]() {
+            size_t n = std::fwrite(bytes.data(), 1, bytes.size(), out);
+            written += n;
+            return n == bytes.size();
+        });
+        current = 1 - current;
+    }
+    return !writer.valid() || writer.get();
+}
+
+#endif // MESH_EXPORT_H
@@ -0,0 +1,123 @@
+/*
+ * point_cloud.h - The 3D gasket as a chaos-game point cloud
+ *
+ * Instead of a subdivided mesh, the attractor is sampled by the 3D
+ * chaos game (ParallelIfs from ifs_engine.h, one halfway step towards
+ * each of the four corners as its maps). Nothing depends on a depth,
+ * and memory grows only with the point count.
+ *
+ * generateGasketCloud() sorts the points in place into one section per
+ * corner tetrahedron, so each section is drawn in one color like the
+ * mesh's face sections. depthSortSplats() orders the cloud back to front
+ * for blended, depth-sorted splats.
+ */
+
+#ifndef POINT_CLOUD_H
+#define POINT_CLOUD_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "ifs_engine.h"
+#include "tetrahedron_subdivision.h"
+
+// Floats per splat: x, y, z and r, g, b, a
+const int FLOATS_PER_SPLAT = 7;
+
+/*
+ * Corner tetrahedron of `corners` that point p lies in. The distance
+ * from p to vertex k only shrinks as p's barycentric weight on k grows
+ * (the tetrahedron is regular), so that is the corner p is nearest.
+ */
+inline int nearestCorner(const float* p, const point3 corners[4]) {
+    int nearest = 0;
+    float best = HUGE_VALF;
+    for (int k = 0; k < 4; k++) {
+        float dx = p[0] - corners[k][0];
+        float dy = p[1] - corners[k][1];
+        float dz = p[2] - corners[k][2];
+        float distance = dx * dx + dy * dy + dz * dz;
+        if (distance < best) {
+            best = distance;
+            nearest = k;
+        }
+    }
+    return nearest;
+}
+
+/*
+ * Generate `count` points of the gasket on `corners` into cloud on
+ * `threads` threads (seed and burnIn as ParallelChaosGame), then move
+ * each into its corner's section: corner k's points are
+ * sections[k] to sections[k + 1].
+ */
+inline void generateGasketCloud(const point3 corners[4], long long count, uint64_t seed,
+                                int threads, long long burnIn, std::vector<float>& cloud,
+                                size_t sections[NUM_FACES + 1]) {
+    IfsSystem system;
+    system.dimensions = 3;
+    for (int k = 0; k < 4; k++) {
+        system.addContraction(corners[k], 0.5f, 1.0);
+    }
+    ParallelIfs<Xoshiro256, 3> game(system, seed, threads, burnIn);
+    cloud.resize(FLOATS_PER_VERTEX * count);
+    game.generate(cloud.data(), count);
+
+    size_t counts[NUM_FACES] = {};
+    for (long long i = 0; i < count; i++) {
+        counts[nearestCorner(&cloud[FLOATS_PER_VERTEX * i], corners)]++;
+    }
+    size_t next[NUM_FACES];
+    sections[0] = 0;
+    for (int k = 0; k < NUM_FACES; k++) {
+        next[k] = sections[k];
+        sections[k + 1] = sections[k] + counts[k];
+    }
+    // In place: swap each point into the next free slot of its section
+    for (int k = 0; k < NUM_FACES; k++) {
+        while (next[k] < sections[k + 1]) {
+            float* p = &cloud[FLOATS_PER_VERTEX * next[k]];
+            int corner = nearestCorner(p, corners);
+            if (corner != k) {
+                std::swap_ranges(p, p + FLOATS_PER_VERTEX, &cloud[FLOATS_PER_VERTEX * next[corner]]);
+            }
+            next[corner]++;
+        }
+    }
+}
+
+/*
+ * Fill splats with the cloud (sectioned as generateGasketCloud())
+ * sorted back to front, each point in its section's color with the
+ * given alpha. depthRow is the row of the view rotation that gives a
+ * model point's eye z; only the rotation changes the order.
+ */
+inline void depthSortSplats(const std::vector<float>& cloud, const size_t sections[NUM_FACES + 1],
+                            const double depthRow[3], const float colors[NUM_FACES][3], float alpha,
+                            std::vector<float>& splats) {
+    size_t points = sections[NUM_FACES];
+    std::vector<std::pair<float, uint32_t> > order(points);
+    for (size_t i = 0; i < points; i++) {
+        const float* p = &cloud[FLOATS_PER_VERTEX * i];
+        float z = static_cast<float>(depthRow[0] * p[0] + depthRow[1] * p[1] + depthRow[2] * p[2]);
+        order[i] = std::make_pair(z, static_cast<uint32_t>(i));
+    }
+    // Farthest (most negative eye z) first
+    std::sort(order.begin(), order.end());
+
+    splats.resize(FLOATS_PER_SPLAT * points);
+    float* out = splats.data();
+    for (const std::pair<float, uint32_t>& entry : order) {
+        size_t i = entry.second;
+        int corner = static_cast<int>(std::upper_bound(sections + 1, sections + NUM_FACES, i) -
+                                      (sections + 1));
+        std::copy(&cloud[FLOATS_PER_VERTEX * i], &cloud[FLOATS_PER_VERTEX * (i + 1)], out);
+        std::copy(colors[corner], colors[corner] + 3, out + 3);
+        out[6] = alpha;
+        out += FLOATS_PER_SPLAT;
+    }
+}
+
+#endif // POINT_CLOUD_H
@@ -0,0 +1,203 @@
+/*
+ * prng.h - Fast, seedable, splittable random number generators
+ *
+ * Used by the chaos game in place of rand(). Every generator here
+ * exposes the same small interface so the chaos-game code can be
+ * templated on it:
+ *
+ *   explicit Rng(uint64_t seed)  - deterministic seeding
+ *   uint64_t next()              - 64 uniformly distributed bits
+ *   void jump()                  - skip to a non-overlapping substream
+ *
+ * jump() is what makes the generators splittable: seeding once and
+ * calling jump() k times gives the k-th independent stream, e.g. one
+ * per worker thread, without any correlation between them.
+ */
+
+#ifndef PRNG_H
+#define PRNG_H
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * SplitMix64 step - expands a single 64-bit seed into well mixed
+ * state words, as recommended by the xoshiro authors
+ */
+inline uint64_t splitMix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * xoshiro256** (Blackman & Vigna, 2018)
+ *
+ * Period 2^256 - 1. jump() advances by 2^128 draws, giving 2^128
+ * non-overlapping streams of 2^128 draws each.
+ */
+struct Xoshiro256 {
+    uint64_t s[4];
+
+    explicit Xoshiro256(uint64_t seed = 0) {
+        uint64_t sm = seed;
+        for (int i = 0; i < 4; i++) {
+            s[i] = splitMix64(sm);
+        }
+    }
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    void jump() {
+        static const uint64_t JUMP[4] = {
+            0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+            0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL
+        };
+        uint64_t t[4] = {0, 0, 0, 0};
+        for (int i = 0; i < 4; i++) {
+            for (int b = 0; b < 64; b++) {
+                if (JUMP[i] & (1ULL << b)) {
+                    for (int j = 0; j < 4; j++) t[j] ^= s[j];
+                }
+                next();
+            }
+        }
+        for (int j = 0; j < 4; j++) s[j] = t[j];
+    }
+};
+
+/*
+ * PCG32 (O'Neill, 2014) - XSH-RR output on a 64-bit LCG
+ *
+ * next() combines two 32-bit outputs. Because the state is an LCG
+ * it can be advanced by any distance in O(log n) steps; jump() skips
+ * 2^56 LCG steps, far more than any single run consumes.
+ */
+struct Pcg32 {
+    uint64_t state;
+    uint64_t inc;
+
+    static const uint64_t MULTIPLIER = 6364136223846793005ULL;
+
+    explicit Pcg32(uint64_t seed = 0) {
+        uint64_t sm = seed;
+        inc = splitMix64(sm) | 1u;
+        state = 0;
+        next32();
+        state += splitMix64(sm);
+        next32();
+    }
+
+    uint32_t next32() {
+        uint64_t old = state;
+        state = old * MULTIPLIER + inc;
+        uint32_t xorshifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+        uint32_t rot = static_cast<uint32_t>(old >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+
+    uint64_t next() {
+        uint64_t hi = next32();
+        return (hi << 32) | next32();
+    }
+
+    /*
+     * Advance the LCG by delta steps (Brown, "Random Number Generation
+     * with Arbitrary Strides")
+     */
+    void advance(uint64_t delta) {
+        uint64_t accMult = 1, accPlus = 0;
+        uint64_t curMult = MULTIPLIER, curPlus = inc;
+        while (delta > 0) {
+            if (delta & 1) {
+                accMult *= curMult;
+                accPlus = accPlus * curMult + curPlus;
+            }
+            curPlus = (curMult + 1) * curPlus;
+            curMult *= curMult;
+            delta >>= 1;
+        }
+        state = accMult * state + accPlus;
+    }
+
+    void jump() {
+        advance(1ULL << 56);
+    }
+};
+
+/*
+ * VertexPicker - uniform choices among three vertices, in bulk
+ *
+ * One 64-bit draw is split into 32 two-bit fields. Fields equal to 3
+ * are rejected, so each of 0, 1, 2 is exactly equally likely (no
+ * modulo bias) while the generator is called only once per ~24
+ * choices on average.
+ */
+template <typename Rng>
+class VertexPicker {
+public:
+    explicit VertexPicker(const Rng& generator)
+        : rng(generator), bits(0), remaining(0) {}
+
+    int next() {
+        for (;;) {
+            if (remaining == 0) {
+                bits = rng.next();
+                remaining = 32;
+            }
+            int choice = static_cast<int>(bits & 3);
+            bits >>= 2;
+            remaining--;
+            if (choice != 3) {
+                return choice;
+            }
+        }
+    }
+
+    /*
+     * Fill out[0..count) with choices. Whole draws are unpacked without
+     * branches: every field is stored and the write position only
+     * advances past accepted ones.
+     */
+    void fill(uint8_t* out, size_t count) {
+        size_t n = 0;
+        while (n + 32 <= count) {
+            uint64_t draw = rng.next();
+            for (int k = 0; k < 32; k++) {
+                uint8_t choice = static_cast<uint8_t>(draw & 3);
+                out[n] = choice;
+                n += (choice != 3);
+                draw >>= 2;
+            }
+        }
+        for (; n < count; n++) {
+            out[n] = static_cast<uint8_t>(next());
+        }
+    }
+
+    Rng& generator() {
+        return rng;
+    }
+
+private:
+    Rng rng;
+    uint64_t bits;
+    int remaining;
+};
+
+#endif // PRNG_H
@@ -0,0 +1,271 @@
+/*
+ * subdivision.h - Non-recursive Sierpinski subdivision engine
+ *
+ * Generates the leaf triangles of the subdivision gasket without
+ * recursion, without GL and without allocating: the caller sizes the
+ * output once from gasketTriangleCount() and every leaf is written
+ * contiguously in a single pass.
+ *
+ * The traversal is an "odometer" over the base-3 digits of the leaf
+ * index (digit k = which corner triangle was taken at level k). The
+ * triangle of every level on the current path is kept in a small
+ * fixed array; moving to the next leaf only recomputes the levels
+ * below the lowest digit that changed, so each leaf costs O(1)
+ * midpoint computations on average. Leaves come out in exactly the
+ * order, and with exactly the float values, of the recursive
+ * subdivideTriangle().
+ *
+ * The odometer only walks down to UNROLLED_DEFAULT_LEVELS above the
+ * leaves; each node there is finished by a kernel from
+ * subdivision_kernels.h, unrolled at compile time into straight-line
+ * stores. Pass unrolled = 0 to run the odometer all the way down.
+ *
+ * Leaves smaller than a pixel can be written as a single centroid
+ * point instead of a triangle (generateGasketCentroids2D), and
+ * subpixelDepth() gives the depth at which that happens.
+ *
+ * Both generators can run on several threads. The top levels of the
+ * subdivision are split into independent subtrees; since every subtree
+ * has the same, known number of leaves, each one writes straight into
+ * its own range of the output with no locks, and the result is
+ * identical for any thread count. runSubdivisionTasks() and
+ * subdivisionSplitDepth() are shared with the 3D tetrahedron program.
+ */
+
+#ifndef SUBDIVISION_H
+#define SUBDIVISION_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "subdivision_kernels.h"
+
+// Deepest level the engine supports (3^32 leaves is far beyond memory)
+const int SUBDIVISION_MAX_LEVELS = 32;
+
+// Floats written per leaf triangle: three x, y corners
+const int FLOATS_PER_TRIANGLE_2D = 6;
+
+// Floats written per collapsed leaf: its centroid
+const int FLOATS_PER_POINT_2D = 2;
+
+static_assert(TriangleLeaf2D::FLOATS == FLOATS_PER_TRIANGLE_2D &&
+              CentroidLeaf2D::FLOATS == FLOATS_PER_POINT_2D,
+              "kernel leaf sizes differ from the engine's");
+
+/*
+ * Number of leaf triangles at the given depth: 3^depth
+ */
+constexpr uint64_t gasketTriangleCount(int depth) {
+    uint64_t count = 1;
+    for (int i = 0; i < depth; i++) {
+        count *= 3;
+    }
+    return count;
+}
+
+// Below this many leaves a mesh is generated on the calling thread
+const uint64_t PARALLEL_MIN_LEAVES = 1 << 14;
+
+// Subtrees created per thread, so that threads finishing early can
+// pick up remaining work
+const int TASKS_PER_THREAD = 8;
+
+/*
+ * Number of levels to split into tasks for a tree with `branching`
+ * children per node: enough for TASKS_PER_THREAD subtrees per thread,
+ * never more than depth. 0 (one task) for a single thread or a small
+ * tree.
+ */
+inline int subdivisionSplitDepth(int depth, int branching, int threads) {
+    uint64_t leaves = 1;
+    for (int i = 0; i < depth && leaves < PARALLEL_MIN_LEAVES; i++) {
+        leaves *= branching;
+    }
+    if (threads <= 1 || leaves < PARALLEL_MIN_LEAVES) {
+        return 0;
+    }
+    int split = 0;
+    uint64_t tasks = 1;
+    while (split < depth && tasks < static_cast<uint64_t>(threads) * TASKS_PER_THREAD) {
+        tasks *= branching;
+        split++;
+    }
+    return split;
+}
+
+/*
+ * Run task(i) for every i in [0, count) on up to `threads` threads.
+ * Each thread takes the next unclaimed index from a shared counter
+ * until none are left, so uneven progress balances out. Tasks must
+ * only write to memory no other task touches.
+ */
+template <typename Task>
+inline void runSubdivisionTasks(uint64_t count, int threads, Task task) {
+    if (threads <= 1 || count <= 1) {
+        for (uint64_t i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+    std::atomic<uint64_t> next(0);
+    auto worker = [&next, count, &task]() {
+        for (uint64_t i = next++; i < count; i = next++) {
+            task(i);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (uint64_t t = 0; t < static_cast<uint64_t>(threads) && t < count; t++) {
+        workers.push_back(std::thread(worker));
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+}
+
+/*
+ * First depth at which a shape extentPixels across on screen has
+ * leaves no larger than one pixel (each level halves the size)
+ */
+inline int subpixelDepth(double extentPixels) {
+    int depth = 0;
+    while (extentPixels > 1.0 && depth < SUBDIVISION_MAX_LEVELS) {
+        extentPixels /= 2.0;
+        depth++;
+    }
+    return depth;
+}
+
+/*
+ * Corner triangle `corner` (0, 1, 2) of triangle t, matching the
+ * order of the recursive calls in subdivideTriangle()
+ */
+inline void childTriangle2D(const float t[6], int corner, float out[6]) {
+    const float* a = t;
+    const float* b = t + 2;
+    const float* c = t + 4;
+    float ab[2] = {(a[0] + b[0]) / 2.0f, (a[1] + b[1]) / 2.0f};
+    float bc[2] = {(b[0] + c[0]) / 2.0f, (b[1] + c[1]) / 2.0f};
+    float ca[2] = {(c[0] + a[0]) / 2.0f, (c[1] + a[1]) / 2.0f};
+    const float* corners[3][3] = {
+        {a, ab, ca},    // Bottom-left
+        {ab, b, bc},    // Bottom-right
+        {ca, bc, c}     // Top
+    };
+    for (int i = 0; i < 3; i++) {
+        out[2 * i] = corners[corner][i][0];
+        out[2 * i + 1] = corners[corner][i][1];
+    }
+}
+
+/*
+ * Visit all gasketTriangleCount(depth) leaves of the triangle
+ * (a, b, c) in order, calling emit(leaf) with the leaf's six corner
+ * coordinates. depth must not exceed SUBDIVISION_MAX_LEVELS.
+ */
+template <typename Emit>
+inline void traverseGasket2D(const float a[2], const float b[2], const float c[2],
+                             int depth, Emit emit) {
+    float levels[SUBDIVISION_MAX_LEVELS + 1][6];
+    int digits[SUBDIVISION_MAX_LEVELS + 1];
+
+    // Start on the all-zero path: leftmost child at every level
+    const float root[6] = {a[0], a[1], b[0], b[1], c[0], c[1]};
+    for (int i = 0; i < 6; i++) {
+        levels[0][i] = root[i];
+    }
+    for (int level = 1; level <= depth; level++) {
+        digits[level] = 0;
+        childTriangle2D(levels[level - 1], 0, levels[level]);
+    }
+
+    for (;;) {
+        emit(levels[depth]);
+
+        // Advance the odometer: carry past digits that are already 2
+        int level = depth;
+        while (level > 0 && digits[level] == 2) {
+            digits[level] = 0;
+            level--;
+        }
+        if (level == 0) {
+            return;
+        }
+        digits[level]++;
+        for (int l = level; l <= depth; l++) {
+            childTriangle2D(levels[l - 1], digits[l], levels[l]);
+        }
+    }
+}
+
+/*
+ * Split the gasket `split` levels below the root into 3^split subtrees
+ * and run work(index, corners, split) for each on `threads` threads.
+ * Subtree i holds leaves [i * 3^(depth - split), (i + 1) * 3^(depth - split))
+ * of the full traversal order.
+ */
+template <typename Work>
+inline void forEachSubtree2D(const float a[2], const float b[2], const float c[2],
+                             int depth, int threads, Work work) {
+    int split = subdivisionSplitDepth(depth, 3, threads);
+    uint64_t tasks = gasketTriangleCount(split);
+    runSubdivisionTasks(tasks, threads, [&](uint64_t task) {
+        float corners[6] = {a[0], a[1], b[0], b[1], c[0], c[1]};
+        // Walk down along the base-3 digits of the task, most significant first
+        uint64_t place = tasks;
+        for (int level = 0; level < split; level++) {
+            place /= 3;
+            float child[6];
+            childTriangle2D(corners, static_cast<int>(task / place % 3), child);
+            for (int i = 0; i < 6; i++) {
+                corners[i] = child[i];
+            }
+        }
+        work(task, corners, split);
+    });
+}
+
+/*
+ * Write every leaf to out as Leaf stores it: the odometer walks the
+ * upper levels and an unrolled kernel writes the bottom `unrolled`
+ * levels (at most UNROLLED_MAX_DEPTH) of each subtree
+ */
+template <typename Leaf>
+inline void generateUnrolled2D(const float a[2], const float b[2], const float c[2],
+                               int depth, float* out, int threads, int unrolled) {
+    forEachSubtree2D(a, b, c, depth, threads,
+                     [depth, out, unrolled](uint64_t task, const float* corners, int split) {
+        int bottom = std::max(0, std::min({unrolled, UNROLLED_MAX_DEPTH, depth - split}));
+        SubdivisionKernel2D kernel = unrolledKernel2D<Leaf>(bottom);
+        uint64_t kernelFloats = gasketTriangleCount(bottom) * Leaf::FLOATS;
+        float* dst = out + task * gasketTriangleCount(depth - split) * Leaf::FLOATS;
+        traverseGasket2D(corners, corners + 2, corners + 4, depth - split - bottom,
+                         [&dst, kernel, kernelFloats](const float* node) {
+            kernel(node, dst);
+            dst += kernelFloats;
+        });
+    });
+}
+
+/*
+ * Write every leaf triangle to out, FLOATS_PER_TRIANGLE_2D floats each
+ */
+inline void generateGasket2D(const float a[2], const float b[2], const float c[2],
+                             int depth, float* out, int threads = 1,
+                             int unrolled = UNROLLED_DEFAULT_LEVELS) {
+    generateUnrolled2D<TriangleLeaf2D>(a, b, c, depth, out, threads, unrolled);
+}
+
+/*
+ * Write the centroid of every leaf to out, FLOATS_PER_POINT_2D floats
+ * each
+ */
+inline void generateGasketCentroids2D(const float a[2], const float b[2], const float c[2],
+                                      int depth, float* out, int threads = 1,
+                                      int unrolled = UNROLLED_DEFAULT_LEVELS) {
+    generateUnrolled2D<CentroidLeaf2D>(a, b, c, depth, out, threads, unrolled);
+}
+
+#endif // SUBDIVISION_H
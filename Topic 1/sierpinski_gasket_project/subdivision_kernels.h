@@ -0,0 +1,134 @@
+/*
+ * subdivision_kernels.h - Unrolled kernels for the bottom subdivision levels
+ *
+ * The recursive subdivideTriangle() tests depth == 0 at every call,
+ * and the odometer in subdivision.h pays a digit carry per leaf. Near
+ * the leaves both are pure overhead: the shape of the last few levels
+ * is always the same. UnrolledGasket2D<Depth, Leaf> takes the depth as
+ * a template parameter, so the compiler expands the whole subtree into
+ * straight-line code: midpoints kept in registers and a fixed sequence
+ * of stores at offsets known at compile time, with no branches.
+ *
+ * unrolledKernel2D<Leaf>(depth) picks the instantiation for a depth at
+ * runtime from a table of UNROLLED_MAX_DEPTH + 1 functions. The engine
+ * walks the upper levels with the odometer and calls the kernel once
+ * per node UNROLLED_DEFAULT_LEVELS above the leaves.
+ *
+ * Leaf types decide what is stored per leaf: TriangleLeaf2D its three
+ * corners, CentroidLeaf2D its centroid. Midpoints and centroids use
+ * the same float operations as childTriangle2D() and the generators,
+ * so every kernel output is bit-identical to the recursive version.
+ */
+
+#ifndef SUBDIVISION_KERNELS_H
+#define SUBDIVISION_KERNELS_H
+
+#include <cstdint>
+
+// Inline the whole subtree into the kernel: GCC and Clang otherwise
+// stop inlining after a few levels and call out per subtree
+#if defined(__GNUC__)
+    #define SUBDIVISION_INLINE inline __attribute__((always_inline))
+#else
+    #define SUBDIVISION_INLINE inline
+#endif
+
+// Deepest unrolled kernel: 3^6 = 729 leaves of straight-line code
+const int UNROLLED_MAX_DEPTH = 6;
+
+// Levels the generators unroll by default
+const int UNROLLED_DEFAULT_LEVELS = 4;
+
+/*
+ * Store a leaf as its three x, y corners
+ */
+struct TriangleLeaf2D {
+    static const int FLOATS = 6;
+
+    static SUBDIVISION_INLINE void write(float ax, float ay, float bx, float by,
+                                         float cx, float cy, float* out) {
+        out[0] = ax;
+        out[1] = ay;
+        out[2] = bx;
+        out[3] = by;
+        out[4] = cx;
+        out[5] = cy;
+    }
+};
+
+/*
+ * Store a leaf as its x, y centroid
+ */
+struct CentroidLeaf2D {
+    static const int FLOATS = 2;
+
+    static SUBDIVISION_INLINE void write(float ax, float ay, float bx, float by,
+                                         float cx, float cy, float* out) {
+        out[0] = (ax + bx + cx) / 3.0f;
+        out[1] = (ay + by + cy) / 3.0f;
+    }
+};
+
+/*
+ * All 3^Depth leaves of triangle (a, b, c), written to out in the
+ * order of the recursive subdivideTriangle()
+ */
+template <int Depth, typename Leaf>
+struct UnrolledGasket2D {
+    static const uint64_t LEAVES = 3 * UnrolledGasket2D<Depth - 1, Leaf>::LEAVES;
+
+    static SUBDIVISION_INLINE void run(float ax, float ay, float bx, float by,
+                                       float cx, float cy, float* out) {
+        const float abx = (ax + bx) / 2.0f;
+        const float aby = (ay + by) / 2.0f;
+        const float bcx = (bx + cx) / 2.0f;
+        const float bcy = (by + cy) / 2.0f;
+        const float cax = (cx + ax) / 2.0f;
+        const float cay = (cy + ay) / 2.0f;
+        const uint64_t child = UnrolledGasket2D<Depth - 1, Leaf>::LEAVES * Leaf::FLOATS;
+        UnrolledGasket2D<Depth - 1, Leaf>::run(ax, ay, abx, aby, cax, cay, out);             // Bottom-left
+        UnrolledGasket2D<Depth - 1, Leaf>::run(abx, aby, bx, by, bcx, bcy, out + child);     // Bottom-right
+        UnrolledGasket2D<Depth - 1, Leaf>::run(cax, cay, bcx, bcy, cx, cy, out + 2 * child); // Top
+    }
+};
+
+template <typename Leaf>
+struct UnrolledGasket2D<0, Leaf> {
+    static const uint64_t LEAVES = 1;
+
+    static SUBDIVISION_INLINE void run(float ax, float ay, float bx, float by,
+                                       float cx, float cy, float* out) {
+        Leaf::write(ax, ay, bx, by, cx, cy, out);
+    }
+};
+
+/*
+ * Kernel signature
+ *
+ * corners: x, y of the three corners of the subtree's root triangle
+ * out:     receives the subtree's leaves
+ */
+typedef void (*SubdivisionKernel2D)(const float* corners, float* out);
+
+template <int Depth, typename Leaf>
+void unrolledSubtree2D(const float* corners, float* out) {
+    UnrolledGasket2D<Depth, Leaf>::run(corners[0], corners[1], corners[2], corners[3],
+                                       corners[4], corners[5], out);
+}
+
+/*
+ * Kernel writing a depth-`depth` subtree (0 to UNROLLED_MAX_DEPTH)
+ */
+template <typename Leaf>
+inline SubdivisionKernel2D unrolledKernel2D(int depth) {
+    static const SubdivisionKernel2D kernels[] = {
+        unrolledSubtree2D<0, Leaf>, unrolledSubtree2D<1, Leaf>, unrolledSubtree2D<2, Leaf>,
+        unrolledSubtree2D<3, Leaf>, unrolledSubtree2D<4, Leaf>, unrolledSubtree2D<5, Leaf>,
+        unrolledSubtree2D<6, Leaf>
+    };
+    static_assert(sizeof(kernels) / sizeof(kernels[0]) == UNROLLED_MAX_DEPTH + 1,
+                  "one kernel per depth up to UNROLLED_MAX_DEPTH");
+    return kernels[depth];
+}
+
+#endif // SUBDIVISION_KERNELS_H
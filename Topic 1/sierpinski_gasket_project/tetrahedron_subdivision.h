@@ -0,0 +1,166 @@
+/*
+ * tetrahedron_subdivision.h - Recursive subdivision of the 3D gasket
+ *
+ * Each tetrahedron is replaced by the four half-size tetrahedra at its
+ * corners, down to the requested depth. The faces of the leaves are
+ * written sorted by orientation: face f of every leaf goes to its own
+ * section out[f] of the mesh (see FACES), so each section is drawn
+ * with one color and one normal. A face is three x, y, z corners, or
+ * one point at its centroid for leaves smaller than a pixel.
+ *
+ * Every leaf writes the same number of floats, so the output of any
+ * subtree has a known size and position: forEachSubtree3D() splits the
+ * top levels into subtrees run on several threads (with
+ * runSubdivisionTasks() from subdivision.h), and the result is the same
+ * as one recursive call on the whole tetrahedron.
+ */
+
+#ifndef TETRAHEDRON_SUBDIVISION_H
+#define TETRAHEDRON_SUBDIVISION_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include "gasket_geometry.h"
+#include "subdivision.h"
+
+// 3D point structure
+typedef float point3[3];
+
+// The four faces of every tetrahedron (indices into its vertices), in
+// the order of the face sections
+const int NUM_FACES = 4;
+const int FACES[NUM_FACES][3] = {{0, 1, 2}, {0, 2, 3}, {0, 3, 1}, {1, 3, 2}};
+
+// Floats per stored vertex: x, y, z
+const int FLOATS_PER_VERTEX = 3;
+
+/*
+ * Write a triangle at out and advance out
+ */
+inline void addTriangle(const point3 a, const point3 b, const point3 c, float*& out) {
+    const float* corners[3] = {a, b, c};
+    for (int i = 0; i < 3; i++) {
+        std::copy(corners[i], corners[i] + 3, out);
+        out += FLOATS_PER_VERTEX;
+    }
+}
+
+/*
+ * Write one point for a sub-pixel face, its centroid, at out and
+ * advance out
+ */
+inline void addFacePoint(const point3 a, const point3 b, const point3 c, float*& out) {
+    out[0] = (a[0] + b[0] + c[0]) / 3.0f;
+    out[1] = (a[1] + b[1] + c[1]) / 3.0f;
+    out[2] = (a[2] + b[2] + c[2]) / 3.0f;
+    out += FLOATS_PER_VERTEX;
+}
+
+/*
+ * Add a face to the mesh as a triangle, or as a point when the mesh
+ * holds collapsed sub-pixel tetrahedra
+ */
+inline void addFace(const point3 a, const point3 b, const point3 c, bool points, float*& out) {
+    if (points) {
+        addFacePoint(a, b, c, out);
+    } else {
+        addTriangle(a, b, c, out);
+    }
+}
+
+/*
+ * Recursive tetrahedron subdivision
+ *
+ * Algorithm:
+ * 1. If depth is 0, add the four faces of the tetrahedron to the mesh
+ * 2. Otherwise, calculate midpoints of all six edges
+ * 3. Recursively subdivide four corner tetrahedra
+ *
+ * Face f is written at out[f], which is advanced past it, as a
+ * triangle or (points) as its centroid.
+ */
+inline void subdivideTetrahedron(const point3 a, const point3 b, const point3 c, const point3 d,
+                                 int depth, bool points, float* out[NUM_FACES]) {
+    if (depth == 0) {
+        // Base case: keep the four triangular faces with different colors
+        addFace(a, b, c, points, out[0]);  // Red
+        addFace(a, c, d, points, out[1]);  // Green
+        addFace(a, d, b, points, out[2]);  // Blue
+        addFace(b, d, c, points, out[3]);  // Yellow
+    } else {
+        // Calculate midpoints of all six edges
+        point3 ab, ac, ad, bc, bd, cd;
+
+        for (int i = 0; i < 3; i++) {
+            ab[i] = (a[i] + b[i]) / 2.0f;
+            ac[i] = (a[i] + c[i]) / 2.0f;
+            ad[i] = (a[i] + d[i]) / 2.0f;
+            bc[i] = (b[i] + c[i]) / 2.0f;
+            bd[i] = (b[i] + d[i]) / 2.0f;
+            cd[i] = (c[i] + d[i]) / 2.0f;
+        }
+
+        // Recursively subdivide four corner tetrahedra
+        subdivideTetrahedron(a, ab, ac, ad, depth - 1, points, out);   // Top
+        subdivideTetrahedron(ab, b, bc, bd, depth - 1, points, out);   // Front
+        subdivideTetrahedron(ac, bc, c, cd, depth - 1, points, out);   // Left
+        subdivideTetrahedron(ad, bd, cd, d, depth - 1, points, out);   // Right
+    }
+}
+
+/*
+ * Corner tetrahedron `corner` (0-3, in the order of the recursive calls
+ * in subdivideTetrahedron) of tetrahedron t
+ */
+inline void cornerTetrahedron(const point3 t[4], int corner, point3 out[4]) {
+    for (int v = 0; v < 4; v++) {
+        for (int i = 0; i < 3; i++) {
+            // Each corner keeps vertex `corner` and moves the others halfway to it
+            out[v][i] = v == corner ? t[v][i] : (t[corner][i] + t[v][i]) / 2.0f;
+        }
+    }
+}
+
+/*
+ * Corner (0-3) taken at `level` (0 = top) on the way down to subtree
+ * `task` of a split-level split: the base-4 digits of the task
+ */
+inline int subtreeCorner(uint64_t task, int split, int level) {
+    return static_cast<int>(task >> (2 * (split - 1 - level))) & 3;
+}
+
+/*
+ * Replace t by its descendant `levels` levels down, taking the corners
+ * given by the base-4 digits of path (as subtreeCorner())
+ */
+inline void descendTetrahedron(point3 t[4], uint64_t path, int levels) {
+    for (int level = 0; level < levels; level++) {
+        point3 child[4];
+        cornerTetrahedron(t, subtreeCorner(path, levels, level), child);
+        std::copy(&child[0][0], &child[0][0] + 12, &t[0][0]);
+    }
+}
+
+/*
+ * Floats of one face section for depth-`depth` leaves, stored as
+ * triangles or (points) centroids
+ */
+inline size_t faceSectionFloats(int depth, bool points) {
+    return tetrahedronCount(depth) * (points ? 1 : 3) * FLOATS_PER_VERTEX;
+}
+
+/*
+ * Run work(task, split) on `threads` threads for each of the 4^split
+ * subtrees the top levels of a depth-`depth` gasket are split into.
+ * Subtree `task` owns the task-th equal slice of the output.
+ */
+template <typename Work>
+inline void forEachSubtree3D(int depth, int threads, Work work) {
+    int split = subdivisionSplitDepth(depth, 4, threads);
+    runSubdivisionTasks(tetrahedronCount(split), threads, [&](uint64_t task) {
+        work(task, split);
+    });
+}
+
+#endif // TETRAHEDRON_SUBDIVISION_H
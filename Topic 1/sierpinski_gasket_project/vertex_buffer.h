@@ -0,0 +1,222 @@
+/*
+ * vertex_buffer.h - Retained vertex buffer for the gasket programs
+ *
+ * Geometry is uploaded to a GPU buffer object once per parameter
+ * change and then drawn with a single glDrawArrays() per frame, instead
+ * of re-sending every vertex through glBegin/glEnd on each redraw.
+ *
+ * Vertices are interleaved floats: position, then optional color, then
+ * optional normal. They are bound with the fixed-function client-state
+ * arrays (glVertexPointer etc.), which is what the GLUT compatibility
+ * contexts used by these programs expect; no shaders or vertex array
+ * objects are needed there.
+ *
+ * Shared-vertex meshes keep their triangles in an IndexBuffer (16 or
+ * 32-bit indices) and are drawn with drawIndexed(), one
+ * glDrawElements() per range.
+ *
+ * Buffer objects need OpenGL 1.5. supported() reports whether they are
+ * available so callers can fall back to immediate mode.
+ */
+
+#ifndef VERTEX_BUFFER_H
+#define VERTEX_BUFFER_H
+
+#ifdef __APPLE__
+    #include <GLUT/glut.h>
+#else
+    #ifndef GL_GLEXT_PROTOTYPES
+        #define GL_GLEXT_PROTOTYPES
+    #endif
+    #include <GL/glut.h>
+#endif
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+class IndexBuffer {
+public:
+    IndexBuffer() : ibo(0), count(0), type(GL_UNSIGNED_INT) {}
+
+    // Number of indices currently stored
+    GLsizei size() const {
+        return count;
+    }
+
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLenum indexType() const {
+        return type;
+    }
+
+    // Buffer object name, 0 until something is assigned
+    GLuint buffer() const {
+        return ibo;
+    }
+
+    // Replace the contents with 16 or 32-bit indices
+    void assign(const std::vector<uint16_t>& indices) {
+        upload(indices.data(), indices.size(), sizeof(uint16_t), GL_UNSIGNED_SHORT);
+    }
+
+    void assign(const std::vector<uint32_t>& indices) {
+        upload(indices.data(), indices.size(), sizeof(uint32_t), GL_UNSIGNED_INT);
+    }
+
+private:
+    GLuint ibo;
+    GLsizei count;
+    GLenum type;
+
+    void upload(const void* data, size_t n, size_t indexSize, GLenum indexType) {
+        if (ibo == 0) {
+            glGenBuffers(1, &ibo);
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, n * indexSize, data, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        count = static_cast<GLsizei>(n);
+        type = indexType;
+    }
+};
+
+class VertexBuffer {
+public:
+    /*
+     * positionSize: floats per position (2 or 3)
+     * colorSize:    floats per color (0 for none, 3 or 4)
+     * normalSize:   floats per normal (0 for none, or 3)
+     */
+    explicit VertexBuffer(int positionSize = 2, int colorSize = 0, int normalSize = 0)
+        : vbo(0), capacity(0), count(0), positionSize(positionSize),
+          colorSize(colorSize), normalSize(normalSize) {}
+
+    /*
+     * Does the current context support buffer objects (GL 1.5+)?
+     * Requires a current GL context.
+     */
+    static bool supported() {
+        const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+        int major = 0, minor = 0;
+        if (version == NULL || std::sscanf(version, "%d.%d", &major, &minor) != 2) {
+            return false;
+        }
+        return major > 1 || (major == 1 && minor >= 5);
+    }
+
+    int floatsPerVertex() const {
+        return positionSize + colorSize + normalSize;
+    }
+
+    // Number of vertices currently stored
+    GLsizei size() const {
+        return count;
+    }
+
+    // Forget the contents but keep the allocation
+    void clear() {
+        count = 0;
+    }
+
+    // Replace the contents with data (floatsPerVertex() floats per vertex)
+    void assign(const std::vector<float>& data) {
+        count = 0;
+        update(data.data(), 0, static_cast<GLsizei>(data.size() / floatsPerVertex()));
+    }
+
+    /*
+     * Upload vertices [first, first + n) of data, which holds the whole
+     * vertex array. Only that range is sent unless the buffer has to
+     * grow, in which case [0, first + n) is re-uploaded.
+     */
+    void update(const float* data, GLsizei first, GLsizei n) {
+        if (vbo == 0) {
+            glGenBuffers(1, &vbo);
+        }
+        GLsizeiptr stride = floatsPerVertex() * sizeof(float);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        if (first + n > capacity) {
+            capacity = first + n > 2 * capacity ? first + n : 2 * capacity;
+            glBufferData(GL_ARRAY_BUFFER, capacity * stride, NULL, GL_STATIC_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, (first + n) * stride, data);
+        } else {
+            glBufferSubData(GL_ARRAY_BUFFER, first * stride, n * stride,
+                            data + static_cast<size_t>(first) * floatsPerVertex());
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (first + n > count) {
+            count = first + n;
+        }
+    }
+
+    // Draw vertices [first, first + n) with a single glDrawArrays()
+    void draw(GLenum mode, GLsizei first, GLsizei n) const {
+        if (vbo == 0 || n <= 0) {
+            return;
+        }
+        bind();
+        glDrawArrays(mode, first, n);
+        unbind();
+    }
+
+    void draw(GLenum mode) const {
+        draw(mode, 0, count);
+    }
+
+    /*
+     * Draw the vertices named by indices [first, first + n) of
+     * indices with a single glDrawElements()
+     */
+    void drawIndexed(GLenum mode, const IndexBuffer& indices, GLsizei first, GLsizei n) const {
+        if (vbo == 0 || indices.buffer() == 0 || n <= 0) {
+            return;
+        }
+        size_t indexSize = indices.indexType() == GL_UNSIGNED_SHORT ? sizeof(uint16_t)
+                                                                    : sizeof(uint32_t);
+        bind();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.buffer());
+        glDrawElements(mode, n, indices.indexType(),
+                       reinterpret_cast<const void*>(static_cast<size_t>(first) * indexSize));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        unbind();
+    }
+
+    void drawIndexed(GLenum mode, const IndexBuffer& indices) const {
+        drawIndexed(mode, indices, 0, indices.size());
+    }
+
+private:
+    GLuint vbo;
+    GLsizei capacity;   // vertices allocated on the GPU
+    GLsizei count;      // vertices stored
+    int positionSize;
+    int colorSize;
+    int normalSize;
+
+    // Bind the buffer and point the client-state arrays into it
+    void bind() const {
+        GLsizei stride = floatsPerVertex() * sizeof(float);
+        const char* offset = NULL;
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(positionSize, GL_FLOAT, stride, offset);
+        offset += positionSize * sizeof(float);
+        if (colorSize > 0) {
+            glEnableClientState(GL_COLOR_ARRAY);
+            glColorPointer(colorSize, GL_FLOAT, stride, offset);
+            offset += colorSize * sizeof(float);
+        }
+        if (normalSize > 0) {
+            glEnableClientState(GL_NORMAL_ARRAY);
+            glNormalPointer(GL_FLOAT, stride, offset);
+        }
+    }
+
+    void unbind() const {
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_NORMAL_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+
+#endif // VERTEX_BUFFER_H
@@ -1,8 +1,28 @@
+// Press F for frame / GL submission / GPU times (see
+// ../../common/frame_timer.h); ./dino --frame-csv times.csv writes one
+// row per frame.
+//
+// ./dino --offscreen --frames 100 --image dino.png renders one
+// animation step per frame without a window (Linux, link with -lEGL;
+// see ../../common/offscreen.h).
+
+#ifdef __APPLE__
 #include <OpenGL/gl.h>
 #include <OpenGL/glu.h>
 #include <GLUT/glut.h>
+#else
+#define GL_GLEXT_PROTOTYPES  // declare timer query entry points
+#include <GL/glu.h>
+#include <GL/glut.h>
+#endif
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <iostream>
 #include <vector>
+#include "../../common/frame_timer.h"
+#include "../../common/offscreen.h"
 
 std::vector<std::vector<std::pair<GLfloat, GLfloat>>> polylines;
 GLfloat dinosaurPosition = 0.0f;  
@@ -11,6 +31,14 @@ GLfloat direction = 1.0f;
 GLfloat walkDirection = 2.0f;  
 GLfloat headNeckAngle = 0.0f;   
 
+// One animation step every 100 ms, scheduled against a fixed clock so
+// the time spent drawing does not slow the walk down
+const int ANIMATION_STEP_MS = 100;
+std::chrono::steady_clock::time_point nextStep;
+
+FrameTimer frameTimer;  // F toggles the overlay
+OffscreenOptions offscreen;
+
 void drawPolyLine(const std::vector<std::pair<GLfloat, GLfloat>>& polyline) {
     glBegin(GL_LINE_STRIP);
     for (const auto& point : polyline) {
@@ -20,6 +48,8 @@ void drawPolyLine(const std::vector<std::pair<GLfloat, GLfloat>>& polyline) {
 }
 
 void display() {
+    frameTimer.beginFrame();
+    frameTimer.beginSubmission();
     glClear(GL_COLOR_BUFFER_BIT);
 
     glPushMatrix();
@@ -95,10 +125,12 @@ void display() {
     }
 
     glPopMatrix();
+    frameTimer.endSubmission();
+    frameTimer.endFrame();
     glFlush();
 }
 
-void animate(int value) {
+void stepAnimation() {
     dinosaurPosition += walkDirection;
 
     legAngle += 3.0f * direction;
@@ -116,9 +148,30 @@ void animate(int value) {
     if (dinosaurPosition > 300.0f || dinosaurPosition < -300.0f) {  // Adjust these values as needed
         walkDirection = -walkDirection;
     }
+}
 
+void animate(int value) {
+    stepAnimation();
     glutPostRedisplay();
-    glutTimerFunc(100, animate, 0);
+
+    // Wait only for what is left of this step; after a stall, restart
+    // the schedule rather than rushing through the missed steps
+    auto now = std::chrono::steady_clock::now();
+    nextStep += std::chrono::milliseconds(ANIMATION_STEP_MS);
+    if (nextStep < now) {
+        nextStep = now;
+    }
+    auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(nextStep - now);
+    glutTimerFunc(static_cast<unsigned int>(delay.count()), animate, 0);
+}
+
+void keyboard(unsigned char key, int x, int y) {
+    if (key == 'f' || key == 'F') {
+        frameTimer.toggleOverlay();
+        glutPostRedisplay();
+    } else if (key == 27) {  // ESC
+        exit(0);
+    }
 }
 void loadPolylines(const char* fileName) {
     std::ifstream inStream;
@@ -144,6 +197,30 @@ void loadPolylines(const char* fileName) {
 int main(int argc, char** argv) {
     loadPolylines("dino.dat");
 
+    for (int i = 1; i < argc; i++) {
+        if (offscreen.parse(argc, argv, i)) {
+            continue;
+        }
+        if (std::strcmp(argv[i], "--frame-csv") == 0 && i + 1 < argc) {
+            if (!frameTimer.openCsv(argv[++i])) {
+                std::cerr << "Error: cannot write " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    if (offscreen.enabled) {
+        offscreen.defaultSize(640, 480);
+        return renderOffscreen(offscreen, frameTimer, false, []() {
+            glMatrixMode(GL_PROJECTION);
+            glLoadIdentity();
+            gluOrtho2D(0, 1024.0, 0, 768.0);
+        }, []() {
+            stepAnimation();
+            display();
+        });
+    }
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
     glutInitWindowSize(640, 480);
@@ -155,7 +232,9 @@ int main(int argc, char** argv) {
     gluOrtho2D(0, 1024.0, 0, 768.0);
 
     glutDisplayFunc(display);
-    glutTimerFunc(100, animate, 0);
+    glutKeyboardFunc(keyboard);
+    nextStep = std::chrono::steady_clock::now() + std::chrono::milliseconds(ANIMATION_STEP_MS);
+    glutTimerFunc(ANIMATION_STEP_MS, animate, 0);
     glutMainLoop();
 
     return(0);
@@ -1,3 +1,10 @@
+// Offscreen (no window, Linux; link with -lEGL as well):
+//   ./HappyFace --offscreen --frames 100 --image happy.png
+// renders into a framebuffer object instead of a GLFW window, prints the
+// frame times and writes the last frame (see ../../common/offscreen.h).
+// --frame-csv PATH writes the time of every frame, with or without a window.
+
+#include <cstring>
 #include <iostream>
 
 // GLEW
@@ -13,6 +20,8 @@
 
 // Other includes
 #include "Shader.h"
+#include "../../common/frame_timer.h"
+#include "../../common/offscreen.h"
 
 
 // Function prototypes
@@ -22,36 +31,64 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 const GLuint WIDTH = 800, HEIGHT = 600;
 
 // The MAIN function, from here we start the application and run the game loop
-int main()
+int main(int argc, char* argv[])
 {
-    // Init GLFW
-    glfwInit();
-    // Set all the required options for GLFW
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-
-    // Create a GLFWwindow object that we can use for GLFW's functions
-    GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "HappyFace with Texture", nullptr, nullptr);
-    if (window == nullptr) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+    OffscreenOptions offscreen;
+    FrameTimer frameTimer;
+    for (int i = 1; i < argc; i++) {
+        if (offscreen.parse(argc, argv, i)) {
+            continue;
+        }
+        if (std::strcmp(argv[i], "--frame-csv") == 0 && i + 1 < argc) {
+            if (!frameTimer.openCsv(argv[++i])) {
+                std::cout << "Failed to write " << argv[i] << std::endl;
+                return -1;
+            }
+        }
     }
-    glfwMakeContextCurrent(window);
 
-    // Set the required callback functions
-    glfwSetKeyCallback(window, key_callback);
+    GLFWwindow* window = nullptr;
+    OffscreenContext offscreenContext;
+    if (offscreen.enabled) {
+        // Same 3.3 core context, but drawing into a framebuffer object
+        offscreen.defaultSize(WIDTH, HEIGHT);
+        if (!offscreenContext.create(offscreen.width, offscreen.height, true)) {
+            return -1;
+        }
+        frameTimer.setHistorySize(offscreen.frames);
+    } else {
+        // Init GLFW
+        glfwInit();
+        // Set all the required options for GLFW
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+
+        // Create a GLFWwindow object that we can use for GLFW's functions
+        window = glfwCreateWindow(WIDTH, HEIGHT, "HappyFace with Texture", nullptr, nullptr);
+        if (window == nullptr) {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+
+        // Set the required callback functions
+        glfwSetKeyCallback(window, key_callback);
+    }
 
     // Set this to true so GLEW knows to use a modern approach to retrieving function pointers and extensions
     glewExperimental = GL_TRUE;
-    // Initialize GLEW to setup the OpenGL Function pointers
+    // Initialize GLEW to setup the OpenGL Function pointers. Offscreen there is
+    // no GLX display, which GLEW reports after it has loaded the GL functions.
     glewInit();
 
-    // Define the viewport dimensions
-    glViewport(0, 0, WIDTH, HEIGHT);
+    // Define the viewport dimensions (the offscreen context sets its own)
+    if (!offscreen.enabled) {
+        glViewport(0, 0, WIDTH, HEIGHT);
+    }
 
 
     // Build and compile our shader program
@@ -140,11 +177,16 @@ int main()
     stbi_image_free(image);
     glBindTexture(GL_TEXTURE_2D, 0);
 
-    // Game loop
-    while (!glfwWindowShouldClose(window))
+    // Game loop (offscreen: a fixed number of frames)
+    int frame = 0;
+    while (offscreen.enabled ? frame < offscreen.frames : !glfwWindowShouldClose(window))
     {
-        // Check if any events have been activiated (key pressed, mouse moved etc.) and call corresponding response functions
-        glfwPollEvents();
+        if (!offscreen.enabled) {
+            // Check if any events have been activiated (key pressed, mouse moved etc.) and call corresponding response functions
+            glfwPollEvents();
+        }
+        frameTimer.beginFrame();
+        frameTimer.beginSubmission();
 
         // Render
         // Clear the colorbuffer
@@ -167,16 +209,27 @@ int main()
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
 
-        // Swap the screen buffers
-        glfwSwapBuffers(window);
+        frameTimer.endSubmission();
+        frameTimer.endFrame();
+        frame++;
+        if (!offscreen.enabled) {
+            // Swap the screen buffers
+            glfwSwapBuffers(window);
+        }
+    }
+    int status = 0;
+    if (offscreen.enabled) {
+        status = finishOffscreen(offscreenContext, offscreen, frameTimer);
     }
     // Properly de-allocate all resources once they've outlived their purpose
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
     // Terminate GLFW, clearing any resources allocated by GLFW.
-    glfwTerminate();
-    return 0;
+    if (!offscreen.enabled) {
+        glfwTerminate();
+    }
+    return status;
 }
 
 // Is called whenever a key is pressed/released via GLFW
@@ -4,6 +4,18 @@
  * 
  * This program recreates a stairwell scene from a photograph using OpenGL primitives,
  * transformations, and shaders.
+ *
+ * Offscreen (no window, Linux):
+ *   ./stairwell_scene --offscreen --frames 100 --image stairwell.png
+ * renders from the starting camera into a framebuffer object, prints the frame
+ * times and writes the last frame (see ../common/offscreen.h). --frame-csv PATH
+ * writes the time of every frame, with or without a window.
+ *
+ * --bricks N fills the two brick walls with about N smaller bricks (240 in the
+ * photographed scene), and --bench-json PATH appends an offscreen run's results
+ * to PATH as one JSON line (see ../common/bench_report.h), e.g. to measure how
+ * the per-brick draw calls scale:
+ *   ./stairwell_scene --offscreen --frames 20 --bricks 100000 --bench-json bench.jsonl
  */
 
 #include <GL/glew.h>
@@ -15,6 +27,14 @@
 #include <vector>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "../common/bench_report.h"
+#include "../common/frame_timer.h"
+#include "../common/offscreen.h"
 
 // Window dimensions
 const unsigned int SCREEN_WIDTH = 1200;
@@ -34,11 +54,17 @@ bool firstMouse = true;
 float yaw = -90.0f;
 float pitch = 0.0f;
 
+// Bricks in the two walls (--bricks N). The scene has 20 rows of 8 bricks on the
+// left wall and of 4 on the right; other counts scale the bricks to fit.
+const int SCENE_BRICKS = 240;
+int brickCount = SCENE_BRICKS;
+
 // Function prototypes
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void processInput(GLFWwindow* window);
 unsigned int loadShader(const char* vertexPath, const char* fragmentPath);
+void brickLayout(int& rows, int& leftColumns, int& rightColumns, float& scale);
 void renderBrickWall(unsigned int shaderProgram);
 void renderDoor(unsigned int shaderProgram);
 void renderSigns(unsigned int shaderProgram);
@@ -95,31 +121,66 @@ float cubeVertices[] = {
 // Global VAO and VBO
 unsigned int cubeVAO, cubeVBO;
 
-int main() {
-    // Initialize GLFW
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+int main(int argc, char** argv) {
+    OffscreenOptions offscreen;
+    FrameTimer frameTimer;
+    BenchReport benchReport;
+    for (int i = 1; i < argc; i++) {
+        if (offscreen.parse(argc, argv, i) || benchReport.parse(argc, argv, i)) {
+            continue;
+        }
+        if (strcmp(argv[i], "--frame-csv") == 0 && i + 1 < argc) {
+            if (!frameTimer.openCsv(argv[++i])) {
+                std::cout << "Failed to write " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--bricks") == 0 && i + 1 < argc) {
+            // strtod accepts both 1000000 and 1e6
+            brickCount = static_cast<int>(std::strtod(argv[++i], NULL));
+            if (brickCount < 1) {
+                std::cout << "--bricks must be at least 1" << std::endl;
+                return -1;
+            }
+        }
+    }
+
+    GLFWwindow* window = NULL;
+    OffscreenContext offscreenContext;
+    if (offscreen.enabled) {
+        // Same 3.3 core context, but drawing into a framebuffer object
+        offscreen.defaultSize(SCREEN_WIDTH, SCREEN_HEIGHT);
+        if (!offscreenContext.create(offscreen.width, offscreen.height, true)) {
+            return -1;
+        }
+        frameTimer.setHistorySize(offscreen.frames);
+    } else {
+        // Initialize GLFW
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // Create window
-    GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Stairwell Scene - OpenGL", NULL, NULL);
-    if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        // Create window
+        window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Stairwell Scene - OpenGL", NULL, NULL);
+        if (window == NULL) {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    // Initialize GLEW
-    if (glewInit() != GLEW_OK) {
+    // Initialize GLEW. Offscreen there is no GLX display, which GLEW reports
+    // after it has loaded the GL functions.
+    GLenum glewStatus = glewInit();
+    if (glewStatus != GLEW_OK && !(offscreen.enabled && glewStatus == GLEW_ERROR_NO_GLX_DISPLAY)) {
         std::cout << "Failed to initialize GLEW" << std::endl;
         return -1;
     }
@@ -145,15 +206,20 @@ int main() {
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    // Main render loop
-    while (!glfwWindowShouldClose(window)) {
-        // Per-frame time logic
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // Input
-        processInput(window);
+    // Main render loop (offscreen: a fixed number of frames from the starting camera)
+    int frame = 0;
+    while (offscreen.enabled ? frame < offscreen.frames : !glfwWindowShouldClose(window)) {
+        if (!offscreen.enabled) {
+            // Per-frame time logic
+            float currentFrame = glfwGetTime();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+
+            // Input
+            processInput(window);
+        }
+        frameTimer.beginFrame();
+        frameTimer.beginSubmission();
 
         // Render
         glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
@@ -183,9 +249,36 @@ int main() {
         renderCeiling(shaderProgram);
         renderLight(shaderProgram);
 
-        // Swap buffers and poll events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        frameTimer.endSubmission();
+        frameTimer.endFrame();
+        frame++;
+        if (!offscreen.enabled) {
+            // Swap buffers and poll events
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+    }
+    int status = 0;
+    if (offscreen.enabled) {
+        status = finishOffscreen(offscreenContext, offscreen, frameTimer);
+    }
+    if (offscreen.enabled && status == 0) {
+        int rows, leftColumns, rightColumns;
+        float scale;
+        brickLayout(rows, leftColumns, rightColumns, scale);
+        int bricks = rows * (leftColumns + rightColumns);
+        benchReport.addString("program", "stairwell_scene");
+        benchReport.addString("mode", "offscreen");
+        benchReport.addInteger("bricks", bricks);
+        benchReport.addInteger("width", offscreen.width);
+        benchReport.addInteger("height", offscreen.height);
+        benchReport.addFrameTimes(frameTimer);
+        // One draw call per brick: how many the submission time allows
+        benchReport.addRate("bricks_per_second", bricks, frameTimer.stats(FrameTimer::SUBMISSION).avg);
+        benchReport.addPeakMemory();
+        if (!benchReport.write()) {
+            status = -1;
+        }
     }
 
     // Clean up
@@ -193,8 +286,10 @@ int main() {
     glDeleteBuffers(1, &cubeVBO);
     glDeleteProgram(shaderProgram);
 
-    glfwTerminate();
-    return 0;
+    if (!offscreen.enabled) {
+        glfwTerminate();
+    }
+    return status;
 }
 
 /**
@@ -206,15 +301,19 @@ void renderBrickWall(unsigned int shaderProgram) {
     glm::vec3 brickColor(0.7f, 0.35f, 0.2f);
     glUniform3fv(glGetUniformLocation(shaderProgram, "objectColor"), 1, glm::value_ptr(brickColor));
 
+    int rows, leftColumns, rightColumns;
+    float scale;
+    brickLayout(rows, leftColumns, rightColumns, scale);
+
     // Dimensions for brick wall
-    float brickWidth = 0.4f;
-    float brickHeight = 0.15f;
+    float brickWidth = 0.4f / scale;
+    float brickHeight = 0.15f / scale;
     float brickDepth = 0.2f;
-    float mortarGap = 0.02f;
+    float mortarGap = 0.02f / scale;
 
     // Render bricks in a pattern (left wall)
-    for (int row = 0; row < 20; row++) {
-        int bricksInRow = 8;
+    for (int row = 0; row < rows; row++) {
+        int bricksInRow = leftColumns;
         float offset = (row % 2 == 0) ? 0.0f : brickWidth / 2.0f;
         
         for (int col = 0; col < bricksInRow; col++) {
@@ -233,15 +332,15 @@ void renderBrickWall(unsigned int shaderProgram) {
     }
 
     // Render bricks for right wall (partial view)
-    for (int row = 0; row < 20; row++) {
-        int bricksInRow = 4;
+    for (int row = 0; row < rows; row++) {
+        int bricksInRow = rightColumns;
         float offset = (row % 2 == 0) ? 0.0f : brickWidth / 2.0f;
         
         for (int col = 0; col < bricksInRow; col++) {
             glm::mat4 model = glm::mat4(1.0f);
             float x = 1.5f + offset + col * (brickWidth + mortarGap);
             float y = -1.0f + row * (brickHeight + mortarGap);
-            float z = -2.0f + col * 0.3f; // Angle the wall
+            float z = -2.0f + col * 0.3f / scale; // Angle the wall
             
             model = glm::translate(model, glm::vec3(x, y, z));
             model = glm::scale(model, glm::vec3(brickWidth, brickHeight, brickDepth));
@@ -253,6 +352,17 @@ void renderBrickWall(unsigned int shaderProgram) {
     }
 }
 
+/**
+ * Rows and bricks per row of the two walls for about brickCount bricks, and the
+ * factor the bricks are scaled down by (1 for the scene's 240)
+ */
+void brickLayout(int& rows, int& leftColumns, int& rightColumns, float& scale) {
+    scale = std::sqrt(brickCount / static_cast<float>(SCENE_BRICKS));
+    rows = std::max(1, static_cast<int>(std::lround(20 * scale)));
+    leftColumns = std::max(1, static_cast<int>(std::lround(8 * scale)));
+    rightColumns = std::max(1, static_cast<int>(std::lround(4 * scale)));
+}
+
 /**
  * Renders the door with frame and window
  * Uses multiple scaled cubes to create door structure
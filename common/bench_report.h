@@ -0,0 +1,177 @@
+/*
+ * bench_report.h - Machine-readable benchmark results
+ *
+ * A BenchReport collects the parameters and measurements of one run
+ * and appends them to the file given with --bench-json PATH as one
+ * JSON object per line:
+ *
+ *   {"program":"gasket_2d_subdivision","mode":"offscreen","depth":10,...}
+ *
+ * A sweep (see bench.sh in the gasket project) runs the programs many
+ * times with the same file, so every run ends up on its own line and
+ * the results of two commits can be diffed line by line.
+ *
+ * addFrameTimes() adds min / avg / p99 / total of every FrameTimer
+ * column, addPeakMemory() the resident-set high-water mark of the
+ * process (null on Windows, which has no getrusage()).
+ */
+
+#ifndef BENCH_REPORT_H
+#define BENCH_REPORT_H
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#ifndef _WIN32
+    #include <sys/resource.h>
+#endif
+#include "frame_timer.h"
+
+/*
+ * Largest resident set of this process so far, in bytes, or -1 if
+ * the platform does not report it
+ */
+inline long long peakMemoryBytes() {
+#ifdef _WIN32
+    return -1;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss;             // bytes on macOS
+#else
+    return usage.ru_maxrss * 1024LL;    // kilobytes on Linux
+#endif
+#endif
+}
+
+class BenchReport {
+public:
+    BenchReport() : path(NULL) {}
+
+    /*
+     * Consume --bench-json PATH at argv[i], advancing i past its
+     * value. Returns false for any other argument.
+     */
+    bool parse(int argc, char** argv, int& i) {
+        if (std::strcmp(argv[i], "--bench-json") == 0 && i + 1 < argc) {
+            path = argv[++i];
+            return true;
+        }
+        return false;
+    }
+
+    // Was --bench-json given?
+    bool enabled() const {
+        return path != NULL;
+    }
+
+    void addString(const char* name, const char* value) {
+        std::string quoted = "\"";
+        for (const char* c = value; *c != '\0'; c++) {
+            if (*c == '"' || *c == '\\') {
+                quoted += '\\';
+            }
+            quoted += *c;
+        }
+        addJson(name, quoted + "\"");
+    }
+
+    void addInteger(const char* name, long long value) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%lld", value);
+        addJson(name, text);
+    }
+
+    void addBool(const char* name, bool value) {
+        addJson(name, value ? "true" : "false");
+    }
+
+    // NaN and infinity (which JSON cannot hold) are written as null
+    void addNumber(const char* name, double value) {
+        addJson(name, number(value));
+    }
+
+    /*
+     * count / (milliseconds / 1000), or null when nothing was timed
+     */
+    void addRate(const char* name, double count, double milliseconds) {
+        addJson(name, milliseconds > 0.0 ? number(count / (milliseconds / 1000.0)) : "null");
+    }
+
+    /*
+     * Number of recorded frames and the statistics of every column,
+     * e.g. "submission_ms":{"min":0.41,"avg":0.52,"p99":0.9,"total":10.4}
+     */
+    void addFrameTimes(const FrameTimer& timer) {
+        static const char* const names[] = {"frame_ms", "cpu_ms", "generation_ms",
+                                             "submission_ms", "gpu_ms"};
+        addInteger("frames", static_cast<long long>(timer.stats(FrameTimer::FRAME).count));
+        for (int column = FrameTimer::FRAME; column <= FrameTimer::GPU; column++) {
+            FrameTimer::Stats stats = timer.stats(static_cast<FrameTimer::Column>(column));
+            if (stats.count == 0) {
+                addJson(names[column], "null");
+                continue;
+            }
+            addJson(names[column], "{\"min\":" + number(stats.min) +
+                                   ",\"avg\":" + number(stats.avg) +
+                                   ",\"p99\":" + number(stats.p99) +
+                                   ",\"total\":" + number(stats.total) + "}");
+        }
+    }
+
+    void addPeakMemory() {
+        long long bytes = peakMemoryBytes();
+        if (bytes >= 0) {
+            addInteger("peak_memory_bytes", bytes);
+        } else {
+            addJson("peak_memory_bytes", "null");
+        }
+    }
+
+    /*
+     * Append the collected fields as one line to the --bench-json file.
+     * Does nothing without --bench-json; returns false (after printing
+     * why) if the file cannot be written.
+     */
+    bool write() const {
+        if (path == NULL) {
+            return true;
+        }
+        FILE* file = std::fopen(path, "a");
+        if (file == NULL) {
+            std::fprintf(stderr, "Error: cannot write %s\n", path);
+            return false;
+        }
+        std::fprintf(file, "{%s}\n", fields.c_str());
+        return std::fclose(file) == 0;
+    }
+
+private:
+    const char* path;
+    std::string fields;     // "name":value pairs, comma separated
+
+    void addJson(const char* name, const std::string& value) {
+        if (!fields.empty()) {
+            fields += ',';
+        }
+        fields += '"';
+        fields += name;
+        fields += "\":";
+        fields += value;
+    }
+
+    static std::string number(double value) {
+        if (!std::isfinite(value)) {
+            return "null";
+        }
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.6g", value);
+        return text;
+    }
+};
+
+#endif // BENCH_REPORT_H
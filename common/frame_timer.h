@@ -0,0 +1,414 @@
+/*
+ * frame_timer.h - Frame timing and on-screen statistics for the GLUT
+ * programs
+ *
+ * Per frame it records:
+ *   frame       time since the previous frame ended (1000 / fps)
+ *   cpu         time spent in the display callback
+ *   generation  CPU time spent building geometry (wherever the program
+ *               marks it, e.g. in an idle callback before the frame)
+ *   submission  CPU time spent issuing GL drawing calls
+ *   gpu         GPU time of the submitted calls, from GL_TIME_ELAPSED
+ *               timer queries
+ *
+ * Rolling min / avg / p99 over the last frames can be drawn as a text
+ * overlay, and every frame can be written as one CSV row for tracking
+ * regressions. GPU times arrive a few frames late (the queries are
+ * read without stalling), so rows are written once their GPU time is
+ * known.
+ *
+ * Usage in a display callback:
+ *
+ *   frameTimer.beginFrame();
+ *   frameTimer.beginGeneration();  ...build geometry...  frameTimer.endGeneration();
+ *   frameTimer.beginSubmission();  ...draw...            frameTimer.endSubmission();
+ *   frameTimer.endFrame();         // draws the overlay when enabled
+ *   glutSwapBuffers();
+ *
+ * Timer queries need OpenGL 3.3. Without them (e.g. the OpenGL 2.1
+ * contexts GLUT creates on macOS) the gpu column is left empty. They
+ * are called directly, so they are compiled in only where libGL
+ * exports them (not on macOS or Windows).
+ *
+ * Only the overlay needs GLUT (for its bitmap font): include glut.h
+ * before this header to get it. Programs using GLEW include glew.h
+ * first instead and can still record, summarize and write CSV.
+ */
+
+#ifndef FRAME_TIMER_H
+#define FRAME_TIMER_H
+
+#ifdef __APPLE__
+    #include <OpenGL/gl.h>
+#else
+    #ifndef GL_GLEXT_PROTOTYPES
+        #define GL_GLEXT_PROTOTYPES
+    #endif
+    #include <GL/gl.h>      // nothing new if GLEW was included first
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#if !defined(__APPLE__) && !defined(_WIN32)
+    #define FRAME_TIMER_GPU_QUERIES
+#endif
+
+class FrameTimer {
+public:
+    // Columns of a frame's record
+    enum Column { FRAME, CPU, GENERATION, SUBMISSION, GPU };
+
+    // Statistics of one column over the recorded frames
+    struct Stats {
+        size_t count;       // frames that have a value (0: none measured)
+        double last;
+        double min;
+        double avg;
+        double p99;
+        double total;
+    };
+
+    // historySize: number of frames the rolling statistics cover
+    explicit FrameTimer(size_t historySize = 120)
+        : historySize(historySize), historyNext(0), frameCount(0), overlay(false),
+          csv(NULL), gpuChecked(false), gpuTiming(false), pendingFirst(0),
+          pendingCount(0), generationStart(), submissionStart(), frameStart(),
+          lastFrameEnd(), started(false), lastDelta(0.0) {
+        current = Sample();
+    }
+
+    ~FrameTimer() {
+        if (csv != NULL) {
+            std::fclose(csv);
+        }
+    }
+
+    /*
+     * Write one CSV row per frame to path. Returns false if the file
+     * cannot be opened.
+     */
+    bool openCsv(const char* path) {
+        csv = std::fopen(path, "w");
+        if (csv == NULL) {
+            return false;
+        }
+        std::fprintf(csv, "frame,frame_ms,cpu_ms,generation_ms,submission_ms,gpu_ms\n");
+        return true;
+    }
+
+    /*
+     * Keep statistics over the last frames frames, discarding what has
+     * been recorded so far (e.g. to summarize a whole offscreen run)
+     */
+    void setHistorySize(size_t frames) {
+        historySize = frames > 0 ? frames : 1;
+        history.clear();
+        historyNext = 0;
+    }
+
+    void toggleOverlay() {
+        overlay = !overlay;
+    }
+
+    bool overlayEnabled() const {
+        return overlay;
+    }
+
+    /*
+     * Seconds between the ends of the last two frames (0 before the
+     * second frame), for advancing animations independently of the
+     * frame rate
+     */
+    double frameDelta() const {
+        return lastDelta;
+    }
+
+    void beginFrame() {
+        frameStart = Clock::now();
+    }
+
+    void beginGeneration() {
+        generationStart = Clock::now();
+    }
+
+    void endGeneration() {
+        current.generationMs += msSince(generationStart);
+    }
+
+    void beginSubmission() {
+        submissionStart = Clock::now();
+#ifdef FRAME_TIMER_GPU_QUERIES
+        if (!gpuChecked) {
+            // The first submission is left untimed: it carries one-off
+            // setup work, and some drivers (Mesa llvmpipe) return garbage
+            // for the first query of a context
+            gpuTiming = timerQueriesSupported();
+            if (gpuTiming) {
+                glGenQueries(QUERY_SLOTS, queries);
+            }
+            gpuChecked = true;
+        } else if (gpuTiming) {
+            if (pendingCount == QUERY_SLOTS) {
+                collect(true);  // all queries in flight: wait for the oldest
+            }
+            glBeginQuery(GL_TIME_ELAPSED, queries[(pendingFirst + pendingCount) % QUERY_SLOTS]);
+            current.queried = true;
+        }
+#endif
+    }
+
+    void endSubmission() {
+#ifdef FRAME_TIMER_GPU_QUERIES
+        if (current.queried) {
+            glEndQuery(GL_TIME_ELAPSED);
+        }
+#endif
+        current.submissionMs += msSince(submissionStart);
+    }
+
+    /*
+     * Finish the frame: draw the overlay (if enabled) and record the
+     * frame's times. Call before swapping buffers.
+     */
+    void endFrame() {
+        if (overlay) {
+            drawOverlay();
+        }
+        Clock::time_point now = Clock::now();
+        current.frame = frameCount++;
+        current.cpuMs = std::chrono::duration<double, std::milli>(now - frameStart).count();
+        if (started) {
+            lastDelta = std::chrono::duration<double>(now - lastFrameEnd).count();
+            current.frameMs = lastDelta * 1000.0;
+        } else {
+            current.frameMs = current.cpuMs;
+        }
+        lastFrameEnd = now;
+        started = true;
+
+        if (current.queried) {
+            pending[(pendingFirst + pendingCount) % QUERY_SLOTS] = current;
+            pendingCount++;
+        } else {
+            record(current);
+        }
+        current = Sample();
+        collect(false);
+    }
+
+    /*
+     * Wait for the GPU times of all submitted frames, so that every
+     * frame is recorded. Call before exiting or summarizing.
+     */
+    void finish() {
+        while (pendingCount > 0) {
+            collect(true);
+        }
+    }
+
+    /*
+     * Statistics of column over the frames in the history
+     */
+    Stats stats(Column column) const {
+        static double Sample::* const fields[] = {&Sample::frameMs, &Sample::cpuMs,
+            &Sample::generationMs, &Sample::submissionMs, &Sample::gpuMs};
+        double Sample::*field = fields[column];
+        Stats result = {0, 0.0, 0.0, 0.0, 0.0, 0.0};
+        std::vector<double> values;
+        for (size_t i = 0; i < history.size(); i++) {
+            if (history[i].*field >= 0.0) {
+                values.push_back(history[i].*field);
+                result.total += history[i].*field;
+            }
+        }
+        if (values.empty()) {
+            return result;
+        }
+        size_t newest = (historyNext + historySize - 1) % historySize;
+        double last = history[std::min(newest, history.size() - 1)].*field;
+        std::sort(values.begin(), values.end());
+        size_t p99 = std::min(values.size() - 1, static_cast<size_t>(0.99 * values.size()));
+        result.count = values.size();
+        result.last = last < 0.0 ? 0.0 : last;
+        result.min = values.front();
+        result.avg = result.total / values.size();
+        result.p99 = values[p99];
+        return result;
+    }
+
+    /*
+     * Print the statistics table to out, as shown by the overlay
+     */
+    void printSummary(FILE* out) const {
+        char lines[SUMMARY_LINES][96];
+        formatSummary(lines);
+        std::fprintf(out, "Frame times over %zu frames:\n", history.size());
+        for (int i = 0; i < SUMMARY_LINES; i++) {
+            std::fprintf(out, "  %s\n", lines[i]);
+        }
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    static const int SUMMARY_LINES = 6;
+
+    // Timer queries kept in flight before waiting for the oldest
+    static const int QUERY_SLOTS = 4;
+
+    struct Sample {
+        long long frame;
+        double frameMs;
+        double cpuMs;
+        double generationMs;
+        double submissionMs;
+        double gpuMs;       // negative: not measured
+        bool queried;       // a timer query is pending for this frame
+
+        Sample() : frame(0), frameMs(0.0), cpuMs(0.0), generationMs(0.0),
+                   submissionMs(0.0), gpuMs(-1.0), queried(false) {}
+    };
+
+    size_t historySize;
+    std::vector<Sample> history;   // ring of the last historySize frames
+    size_t historyNext;
+    long long frameCount;
+    bool overlay;
+    FILE* csv;
+
+    bool gpuChecked;
+    bool gpuTiming;
+    GLuint queries[QUERY_SLOTS];
+    Sample pending[QUERY_SLOTS];   // frames waiting for their query, oldest first
+    int pendingFirst;
+    int pendingCount;
+
+    Sample current;
+    Clock::time_point generationStart;
+    Clock::time_point submissionStart;
+    Clock::time_point frameStart;
+    Clock::time_point lastFrameEnd;
+    bool started;
+    double lastDelta;
+
+    static double msSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    static bool timerQueriesSupported() {
+        const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+        int major = 0, minor = 0;
+        if (version == NULL || std::sscanf(version, "%d.%d", &major, &minor) != 2) {
+            return false;
+        }
+        return major > 3 || (major == 3 && minor >= 3);
+    }
+
+    /*
+     * Record pending frames, oldest first, whose GPU time is known.
+     * With wait set, block until the oldest one is available.
+     */
+    void collect(bool wait) {
+#ifdef FRAME_TIMER_GPU_QUERIES
+        while (pendingCount > 0) {
+            GLuint query = queries[pendingFirst];
+            GLint available = 0;
+            glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available && !wait) {
+                return;
+            }
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            Sample& sample = pending[pendingFirst];
+            sample.gpuMs = elapsed / 1.0e6;
+            record(sample);
+            pendingFirst = (pendingFirst + 1) % QUERY_SLOTS;
+            pendingCount--;
+            wait = false;
+        }
+#else
+        (void)wait;
+#endif
+    }
+
+    void record(const Sample& sample) {
+        if (history.size() < historySize) {
+            history.push_back(sample);
+        } else {
+            history[historyNext] = sample;
+        }
+        historyNext = (historyNext + 1) % historySize;
+        if (csv != NULL) {
+            std::fprintf(csv, "%lld,%.4f,%.4f,%.4f,%.4f,", sample.frame, sample.frameMs,
+                         sample.cpuMs, sample.generationMs, sample.submissionMs);
+            if (sample.gpuMs >= 0.0) {
+                std::fprintf(csv, "%.4f", sample.gpuMs);
+            }
+            std::fprintf(csv, "\n");
+        }
+    }
+
+    /*
+     * Format "name  last  min  avg  p99" for one column of the history
+     */
+    void formatLine(char* line, size_t size, const char* name, Column column) const {
+        Stats values = stats(column);
+        if (values.count == 0) {
+            std::snprintf(line, size, "%-6s     n/a", name);
+            return;
+        }
+        std::snprintf(line, size, "%-6s %7.2f %7.2f %7.2f %7.2f", name, values.last,
+                      values.min, values.avg, values.p99);
+    }
+
+    void formatSummary(char lines[SUMMARY_LINES][96]) const {
+        std::snprintf(lines[0], 96, "ms         last     min     avg     p99");
+        formatLine(lines[1], 96, "frame", FRAME);
+        formatLine(lines[2], 96, "cpu", CPU);
+        formatLine(lines[3], 96, "gen", GENERATION);
+        formatLine(lines[4], 96, "submit", SUBMISSION);
+        formatLine(lines[5], 96, "gpu", GPU);
+    }
+
+    /*
+     * Draw the statistics as text in the top-left corner of the
+     * viewport, leaving the matrices and render state as they were
+     */
+    void drawOverlay() const {
+#ifdef GLUT_API_VERSION
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glPushAttrib(GL_CURRENT_BIT | GL_ENABLE_BIT | GL_TRANSFORM_BIT);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_LIGHTING);
+        glDisable(GL_TEXTURE_2D);
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        glOrtho(0.0, viewport[2], 0.0, viewport[3], -1.0, 1.0);
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadIdentity();
+
+        char lines[SUMMARY_LINES][96];
+        formatSummary(lines);
+        glColor3f(1.0f, 1.0f, 1.0f);
+        for (int i = 0; i < SUMMARY_LINES; i++) {
+            glRasterPos2i(8, viewport[3] - 16 - 14 * i);
+            for (const char* c = lines[i]; *c != '\0'; c++) {
+                glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *c);
+            }
+        }
+
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPopMatrix();
+        glPopAttrib();
+#endif
+    }
+};
+
+#endif // FRAME_TIMER_H
@@ -0,0 +1,407 @@
+/*
+ * offscreen.h - Render without a window, for benchmarks and image
+ * regression checks on machines with no display
+ *
+ * OffscreenContext creates an OpenGL context through EGL with no
+ * window system at all (Mesa's surfaceless platform, which runs on the
+ * llvmpipe software renderer when there is no GPU) and a framebuffer
+ * object of the requested size that stays bound for all drawing.
+ * writeImage() saves what was drawn as a PPM or PNG file, chosen by the
+ * file extension.
+ *
+ * OffscreenOptions parses the options every program shares:
+ *   --offscreen       render without a window
+ *   --frames N        frames to render (default 100)
+ *   --image PATH      write the last frame to PATH (.ppm or .png)
+ *   --size WxH        framebuffer size (default: the window size)
+ *
+ * and renderOffscreen() runs the frame loop and prints the frame times
+ * recorded by frame_timer.h. Programs with their own render loop
+ * create an OffscreenContext, draw options.frames frames and call
+ * finishOffscreen().
+ *
+ * Rendering with the same options gives the same image on the same
+ * driver, so images from two builds can be compared byte for byte.
+ *
+ * Build: link with -lEGL. EGL is not available on macOS or Windows,
+ * where create() reports that offscreen rendering is not supported.
+ */
+
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+#ifdef __APPLE__
+    #include <OpenGL/gl.h>
+#else
+    #ifndef GL_GLEXT_PROTOTYPES
+        #define GL_GLEXT_PROTOTYPES
+    #endif
+    #include <GL/gl.h>      // nothing new if GLEW was included first
+#endif
+#if !defined(__APPLE__) && !defined(_WIN32)
+    #define OFFSCREEN_EGL
+    #define EGL_NO_X11      // older eglplatform.h would pull in Xlib
+    #include <EGL/egl.h>
+    #include <EGL/eglext.h>
+#endif
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "frame_timer.h"
+
+/*
+ * Write an image given as 8-bit RGB rows, top row first. The format
+ * follows the extension of path: .png, otherwise binary PPM. Returns
+ * false if the file cannot be written.
+ */
+inline bool writeImageFile(const char* path, int width, int height,
+                           const std::vector<uint8_t>& rgb);
+
+class OffscreenContext {
+public:
+    OffscreenContext()
+        : width(0), height(0), framebuffer(0), colorBuffer(0), depthBuffer(0)
+#ifdef OFFSCREEN_EGL
+          , display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT)
+#endif
+    {}
+
+    ~OffscreenContext() {
+#ifdef OFFSCREEN_EGL
+        if (context != EGL_NO_CONTEXT) {
+            glDeleteFramebuffers(1, &framebuffer);
+            glDeleteRenderbuffers(1, &colorBuffer);
+            glDeleteRenderbuffers(1, &depthBuffer);
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroyContext(display, context);
+        }
+        if (display != EGL_NO_DISPLAY) {
+            eglTerminate(display);
+        }
+#endif
+    }
+
+    /*
+     * Create the context and a width x height framebuffer (RGBA8 color,
+     * 24-bit depth) and make both current. coreProfile asks for an
+     * OpenGL 3.3 core context, as GLFW programs do; otherwise the
+     * context is a compatibility one for fixed-function code. Prints
+     * the reason and returns false on failure.
+     */
+    bool create(int w, int h, bool coreProfile = false) {
+#ifndef OFFSCREEN_EGL
+        (void)w; (void)h; (void)coreProfile;
+        std::fprintf(stderr, "Offscreen rendering needs EGL, which this platform does not have\n");
+        return false;
+#else
+        width = w;
+        height = h;
+        if (!openDisplay()) {
+            std::fprintf(stderr, "Offscreen: no EGL display\n");
+            return false;
+        }
+        const EGLint configAttributes[] = {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configs = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configs) || configs < 1) {
+            std::fprintf(stderr, "Offscreen: no EGL config for desktop OpenGL\n");
+            return false;
+        }
+        eglBindAPI(EGL_OPENGL_API);
+        const EGLint coreAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+                                   coreProfile ? coreAttributes : NULL);
+        // No surface: everything is drawn into the framebuffer object
+        if (context == EGL_NO_CONTEXT ||
+            !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            std::fprintf(stderr, "Offscreen: cannot create a surfaceless OpenGL%s context\n",
+                         coreProfile ? " 3.3 core" : "");
+            return false;
+        }
+
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::fprintf(stderr, "Offscreen: framebuffer incomplete\n");
+            return false;
+        }
+        // Draw and read the framebuffer's only color buffer
+        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glViewport(0, 0, width, height);
+        std::fprintf(stderr, "Offscreen: %dx%d, %s, %s\n", width, height,
+                     reinterpret_cast<const char*>(glGetString(GL_RENDERER)),
+                     reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+        return true;
+#endif
+    }
+
+    /*
+     * Read the framebuffer as 8-bit RGB rows, top row first
+     */
+    void readPixels(std::vector<uint8_t>& rgb) const {
+        std::vector<uint8_t> bottomUp(static_cast<size_t>(width) * height * 3);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, bottomUp.data());
+        rgb.resize(bottomUp.size());
+        size_t row = static_cast<size_t>(width) * 3;
+        for (int y = 0; y < height; y++) {
+            std::memcpy(&rgb[y * row], &bottomUp[(height - 1 - y) * row], row);
+        }
+    }
+
+    // Save the framebuffer to path (.png or .ppm)
+    bool writeImage(const char* path) const {
+        std::vector<uint8_t> rgb;
+        readPixels(rgb);
+        return writeImageFile(path, width, height, rgb);
+    }
+
+private:
+    int width;
+    int height;
+    GLuint framebuffer;
+    GLuint colorBuffer;
+    GLuint depthBuffer;
+#ifdef OFFSCREEN_EGL
+    EGLDisplay display;
+    EGLContext context;
+
+    /*
+     * Prefer Mesa's surfaceless platform, which needs no display
+     * server; fall back to the default display (EGL_PLATFORM may
+     * still select a headless platform)
+     */
+    bool openDisplay() {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (getPlatformDisplay != NULL && extensions != NULL &&
+            std::strstr(extensions, "EGL_MESA_platform_surfaceless") != NULL) {
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+                return true;
+            }
+        }
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        return display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL);
+    }
+#endif
+};
+
+/*
+ * Command line options shared by every program's offscreen mode
+ */
+struct OffscreenOptions {
+    bool enabled;
+    int frames;
+    const char* imagePath;  // NULL: no image
+    int width;              // 0: the program's window size
+    int height;
+
+    OffscreenOptions() : enabled(false), frames(100), imagePath(NULL), width(0), height(0) {}
+
+    /*
+     * If argv[i] is one of the offscreen options, take it (and its
+     * value, advancing i) and return true. Exits on a malformed value.
+     */
+    bool parse(int argc, char** argv, int& i) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--offscreen") == 0) {
+            enabled = true;
+        } else if (std::strcmp(argv[i], "--frames") == 0 && hasValue) {
+            frames = std::atoi(argv[++i]);
+            if (frames < 1) {
+                std::fprintf(stderr, "Error: --frames must be at least 1\n");
+                std::exit(1);
+            }
+        } else if (std::strcmp(argv[i], "--image") == 0 && hasValue) {
+            imagePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--size") == 0 && hasValue) {
+            if (std::sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width < 1 || height < 1) {
+                std::fprintf(stderr, "Error: --size expects WIDTHxHEIGHT\n");
+                std::exit(1);
+            }
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Fill in the size the program would open its window with
+    void defaultSize(int windowWidth, int windowHeight) {
+        if (width == 0) {
+            width = windowWidth;
+            height = windowHeight;
+        }
+    }
+};
+
+/*
+ * End of an offscreen run: wait for the GPU, print the frame times of
+ * the whole run and write the last frame to options.imagePath.
+ * Returns the process exit code.
+ */
+inline int finishOffscreen(const OffscreenContext& context, const OffscreenOptions& options,
+                           FrameTimer& timer) {
+    glFinish();
+    timer.finish();
+    timer.printSummary(stderr);
+    if (options.imagePath != NULL) {
+        if (!context.writeImage(options.imagePath)) {
+            std::fprintf(stderr, "Error: cannot write %s\n", options.imagePath);
+            return 1;
+        }
+        std::fprintf(stderr, "Wrote %s\n", options.imagePath);
+    }
+    return 0;
+}
+
+/*
+ * Offscreen mode main loop: create the context, call setup() once,
+ * then frame() options.frames times (frame() draws one frame,
+ * including its FrameTimer calls). Afterwards the last frame is
+ * written to options.imagePath and the frame times of the whole run
+ * are printed. Returns the process exit code.
+ */
+template <typename Setup, typename Frame>
+inline int renderOffscreen(OffscreenOptions& options, FrameTimer& timer, bool coreProfile,
+                           Setup setup, Frame frame) {
+    OffscreenContext context;
+    if (!context.create(options.width, options.height, coreProfile)) {
+        return 1;
+    }
+    setup();
+    timer.setHistorySize(options.frames);
+    for (int i = 0; i < options.frames; i++) {
+        frame();
+    }
+    return finishOffscreen(context, options, timer);
+}
+
+// ---- Image files ----
+
+// CRC-32 as used by PNG chunks
+inline uint32_t pngCrc(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    static uint32_t table[256];
+    static bool tableReady = false;
+    if (!tableReady) {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        tableReady = true;
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+inline void pngPut32(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+inline void pngChunk(FILE* file, const char* type, const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> chunk;
+    pngPut32(chunk, static_cast<uint32_t>(data.size()));
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    pngPut32(chunk, pngCrc(&chunk[4], chunk.size() - 4));
+    std::fwrite(chunk.data(), 1, chunk.size(), file);
+}
+
+/*
+ * PNG without a zlib dependency: the image data is stored in
+ * uncompressed deflate blocks. Files are about as large as a PPM, but
+ * open in any image viewer.
+ */
+inline void writePng(FILE* file, int width, int height, const std::vector<uint8_t>& rgb) {
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    std::fwrite(signature, 1, sizeof(signature), file);
+
+    std::vector<uint8_t> header;
+    pngPut32(header, static_cast<uint32_t>(width));
+    pngPut32(header, static_cast<uint32_t>(height));
+    const uint8_t format[5] = {8, 2, 0, 0, 0};  // 8-bit RGB, no interlace
+    header.insert(header.end(), format, format + 5);
+    pngChunk(file, "IHDR", header);
+
+    // Each row is preceded by filter type 0 (none)
+    size_t row = static_cast<size_t>(width) * 3;
+    std::vector<uint8_t> raw;
+    raw.reserve((row + 1) * height);
+    for (int y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb.begin() + y * row, rgb.begin() + (y + 1) * row);
+    }
+
+    // zlib stream: header, stored blocks of at most 65535 bytes, Adler-32
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    uint32_t a = 1, b = 0;
+    size_t offset = 0;
+    do {
+        size_t length = raw.size() - offset < 65535 ? raw.size() - offset : 65535;
+        bool last = offset + length == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(static_cast<uint8_t>(length));
+        zlib.push_back(static_cast<uint8_t>(length >> 8));
+        zlib.push_back(static_cast<uint8_t>(~length));
+        zlib.push_back(static_cast<uint8_t>(~length >> 8));
+        for (size_t i = offset; i < offset + length; i++) {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+        offset += length;
+    } while (offset < raw.size());
+    pngPut32(zlib, (b << 16) | a);
+    pngChunk(file, "IDAT", zlib);
+    pngChunk(file, "IEND", std::vector<uint8_t>());
+}
+
+inline bool writeImageFile(const char* path, int width, int height,
+                           const std::vector<uint8_t>& rgb) {
+    FILE* file = std::fopen(path, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    size_t length = std::strlen(path);
+    if (length >= 4 && std::strcmp(path + length - 4, ".png") == 0) {
+        writePng(file, width, height, rgb);
+    } else {
+        std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+        std::fwrite(rgb.data(), 1, rgb.size(), file);
+    }
+    return std::fclose(file) == 0;
+}
+
+#endif // OFFSCREEN_H